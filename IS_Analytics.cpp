@@ -0,0 +1,192 @@
+#include "IS_Analytics.h"
+
+/******************************************************************************
+ * 
+ * IS_Analytics - in-situ reductions of the IS_Model fields.
+ * 
+ * Instead of saving every point of the domain, saves per species:
+ *   totals (same normalization as the tissue integrals), maximum value and
+ *   position, radial profile around the infection center, histogram, and
+ *   the position of the bacterial front.
+ * 
+ ******************************************************************************/
+
+using namespace std;
+
+IS_Analytics::IS_Analytics(const std::string& dir, int flags){
+  this->dir   = dir;
+  this->flags = flags;
+  /**
+   * center of the initial infection (see IS_Model::initialize)
+   */
+  center[0]   = 0.45*Xspace;
+  center[1]   = 0.45*Yspace;
+  center[2]   = 0.45*Zspace;
+  frontTol    = pow(10,-3);
+  histBins    = 16;
+  histMin     = pow(10,-6);
+  histMax     = pow(10,2);
+  radialBins  = (int)sqrt((double)(Xspace*Xspace + Yspace*Yspace + Zspace*Zspace)) + 1;
+  dataTotals = dataMax = dataRadial = dataFront = dataHist = NULL;
+}
+
+IS_Analytics::~IS_Analytics(){
+  close();
+}
+
+/**
+ * Setters
+ */
+void IS_Analytics::setCenter(double x, double y, double z){
+  center[0] = x;
+  center[1] = y;
+  center[2] = z;
+}
+void IS_Analytics::setFrontTolerance(double tol){
+  this->frontTol = tol;
+}
+
+/**
+ * Log10 bins between min and max, returns 1 (keeping the previous bins)
+ * unless bins > 0 and 0 < min < max
+ */
+int IS_Analytics::setHistogram(int bins, double min, double max){
+  if (bins <= 0 || !(min > 0.0) || !(min < max)){
+    cout << "Invalid histogram : " << bins << " bins between " << min << " and " << max << "\n";
+    return 1;
+  }
+  this->histBins = bins;
+  this->histMin  = min;
+  this->histMax  = max;
+  return 0;
+}
+
+int IS_Analytics::open(FILE** theFile, const char* name){
+  string fileName = dir + name;
+  *theFile = fopen(fileName.c_str(), "w");
+  if (*theFile==NULL){
+    cout << "Error opening file!!!\n Make sure the path is correct! \n";
+    return 1;
+  }
+  return 0;
+}
+
+void IS_Analytics::close(){
+  if (dataTotals) fclose(dataTotals);
+  if (dataMax)    fclose(dataMax);
+  if (dataRadial) fclose(dataRadial);
+  if (dataFront)  fclose(dataFront);
+  if (dataHist)   fclose(dataHist);
+  dataTotals = dataMax = dataRadial = dataFront = dataHist = NULL;
+}
+
+int IS_Analytics::begin(const IS_Model& model){
+  close();
+  if ((flags & IS_TOTALS) && open(&dataTotals, "Totals.dat")) return 1;
+  if ((flags & IS_MAXIMA) && open(&dataMax, "Max.dat")) return 1;
+  if ((flags & IS_RADIAL) && open(&dataRadial, "Radial.dat")) return 1;
+  if ((flags & IS_FRONT) && open(&dataFront, "Front.dat")) return 1;
+  if ((flags & IS_HISTOGRAM) && open(&dataHist, "Hist.dat")) return 1;
+  radialSum.assign(IS_SPECIES*radialBins, 0.0);
+  radialCount.assign(radialBins, 0);
+  hist.assign(IS_SPECIES*histBins, 0);
+  underflow.assign(IS_SPECIES, 0);
+  nonfinite.assign(IS_SPECIES, 0);
+  return 0;
+}
+
+/**
+ * Computes every reduction in one pass over the domain
+ */
+int IS_Analytics::observe(const IS_Model& model, long int t){
+  IS_View u = model.getFields();
+  double total[IS_SPECIES], maxV[IS_SPECIES];
+  int maxPos[IS_SPECIES][3];
+  double front = 0.0;
+  double logMin = log10(histMin);
+  double binWidth = (log10(histMax) - logMin)/histBins;
+
+  for(int s = 0; s < IS_SPECIES; s++){
+    total[s] = 0.0;
+    maxV[s]  = u(s,0,0,0);
+    maxPos[s][0] = maxPos[s][1] = maxPos[s][2] = 0;
+  }
+  radialSum.assign(IS_SPECIES*radialBins, 0.0);
+  radialCount.assign(radialBins, 0);
+  hist.assign(IS_SPECIES*histBins, 0);
+  underflow.assign(IS_SPECIES, 0);
+  nonfinite.assign(IS_SPECIES, 0);
+
+  for(int x = 0; x < Xspace; x++) {
+    for(int y = 0; y < Yspace; y++) {
+      for(int z = 0; z < Zspace; z++) {
+        double dx = x - center[0], dy = y - center[1], dz = z - center[2];
+        double r  = sqrt(dx*dx + dy*dy + dz*dz);
+        int bin   = (int)r;
+        if (bin >= radialBins) bin = radialBins-1;
+        if (dataRadial) radialCount[bin]++;
+        for(int s = 0; s < IS_SPECIES; s++){
+          double v = u(s,x,y,z);
+          if (!(v <= 0.0)) total[s] += v;
+          if (v > maxV[s] || (isnan(v) && !isnan(maxV[s]))){
+            maxV[s] = v;
+            maxPos[s][0] = x; maxPos[s][1] = y; maxPos[s][2] = z;
+          }
+          if (dataRadial) radialSum[s*radialBins + bin] += v;
+          if (dataHist){
+            if (!isfinite(v)){
+              nonfinite[s]++;
+            } else if (v <= histMin){
+              underflow[s]++;
+            } else {
+              int h = (int)((log10(v) - logMin)/binWidth);
+              if (h < 0) h = 0;
+              if (h >= histBins) h = histBins-1;
+              hist[s*histBins + h]++;
+            }
+          }
+        }
+        if (u(0,x,y,z) > frontTol && r > front) front = r;
+      }
+    }
+  }
+
+  if (dataTotals){
+    fprintf(dataTotals, "%ld", t);
+    for(int s = 0; s < IS_SPECIES; s++) fprintf(dataTotals, " %.6E", total[s]/SPACE);
+    fprintf(dataTotals, "\n");
+  }
+  if (dataMax){
+    fprintf(dataMax, "%ld", t);
+    for(int s = 0; s < IS_SPECIES; s++)
+      fprintf(dataMax, " %.6E %d %d %d", maxV[s], maxPos[s][0], maxPos[s][1], maxPos[s][2]);
+    fprintf(dataMax, "\n");
+  }
+  if (dataRadial){
+    fprintf(dataRadial, "%ld", t);
+    for(int s = 0; s < IS_SPECIES; s++){
+      for(int b = 0; b < radialBins; b++){
+        double mean = radialCount[b] ? radialSum[s*radialBins + b]/radialCount[b] : 0.0;
+        fprintf(dataRadial, " %.4E", mean);
+      }
+    }
+    fprintf(dataRadial, "\n");
+  }
+  if (dataFront){
+    fprintf(dataFront, "%ld %.4E\n", t, front);
+  }
+  if (dataHist){
+    fprintf(dataHist, "%ld", t);
+    for(int s = 0; s < IS_SPECIES; s++){
+      fprintf(dataHist, " %ld %ld", underflow[s], nonfinite[s]);
+      for(int b = 0; b < histBins; b++) fprintf(dataHist, " %ld", hist[s*histBins + b]);
+    }
+    fprintf(dataHist, "\n");
+  }
+  return 0;
+}
+
+int IS_Analytics::end(const IS_Model& model, long int t){
+  close();
+  return 0;
+}
@@ -0,0 +1,63 @@
+#ifndef _IS_Analytics_H_
+#define _IS_Analytics_H_
+
+#include "IS_Model.h"
+
+/**
+ * Reductions computed by IS_Analytics (IS_Config::analytics)
+ */
+const int IS_TOTALS    = 1;  //'Totals.dat' : integral of each species
+const int IS_MAXIMA    = 2;  //'Max.dat'    : maximum of each species and its position
+const int IS_RADIAL    = 4;  //'Radial.dat' : mean of each species by distance to the center
+const int IS_FRONT     = 8;  //'Front.dat'  : distance of the farthest bacteria to the center
+const int IS_HISTOGRAM = 16; //'Hist.dat'   : log10 histogram of each species, values <= histMin
+                             //               and NaN or Inf values counted apart before its bins
+const int IS_ALL       = 31;
+
+/**
+ * In-situ analytics: computes the chosen reductions of the fields in a
+ * single pass over the domain and saves only the results.
+ * Distances are in grid points. A NaN or Inf value makes the total and the
+ * radial mean of its species NaN or Inf, and the maximum is the first NaN
+ * found (with its position).
+ */
+class IS_Analytics : public IS_Observer{
+
+  private:
+
+    std::string dir;
+    int flags;
+    double center[3];   //infection center
+    double frontTol;    //bacteria considered present above this value
+    int histBins;
+    double histMin, histMax; //log10 bins between histMin and histMax
+    int radialBins;
+
+    FILE* dataTotals;
+    FILE* dataMax;
+    FILE* dataRadial;
+    FILE* dataFront;
+    FILE* dataHist;
+
+    std::vector<double> radialSum;
+    std::vector<int> radialCount;
+    std::vector<long int> hist;
+    std::vector<long int> underflow; //values <= histMin (zero or negative included)
+    std::vector<long int> nonfinite; //NaN and Inf values
+
+    int open(FILE** theFile, const char* name);
+    void close();
+
+  public:
+    IS_Analytics(const std::string& dir, int flags);
+    ~IS_Analytics();
+    void setCenter(double x, double y, double z);
+    void setFrontTolerance(double tol);
+    int setHistogram(int bins, double min, double max);
+    int begin(const IS_Model& model);
+    int observe(const IS_Model& model, long int t);
+    int end(const IS_Model& model, long int t);
+
+};
+
+#endif
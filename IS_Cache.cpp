@@ -0,0 +1,516 @@
+#include "IS_Cache.h"
+#include "IS_FileObserver.h"
+#include "IS_Compress.h"
+#include "IS_Health.h"
+#include <algorithm>
+#include <string.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+
+/******************************************************************************
+ *
+ * IS_Cache - content addressed cache of IS_Model results.
+ *
+ * Use-me :
+ *
+ *          IS_Cache cache("cache/");  // at most 1 GB
+ *          cache.solve(config);       // instead of IS_Model(config).solve()
+ *
+ *          Entry files : 'entry.txt' (description and checksums),
+ *                        'series.bin' (t and IS_Scalars of every point),
+ *                        'S_t.isz' (fields), 'end.ckpt' (end state).
+ *
+ *          A run continuing an entry writes 'series.bin.tmp' and
+ *          'end.ckpt.tmp', renamed over the old files once it succeeded;
+ *          'entry.txt' is replaced last (written as 'entry.tmp' and
+ *          renamed), so a failure never leaves an entry that looks valid.
+ *
+ ******************************************************************************/
+
+using namespace std;
+
+static const char CKPT_MAGIC[4] = {'I','S','C','1'};
+static const int  SCALARS       = 9;
+
+/**
+ * Description of a cache entry, read from 'entry.txt'
+ */
+struct IS_CacheEntry{
+  std::string key;
+  long int records;   //points in 'series.bin'
+  long int interval;  //time steps between the points
+  int dumpEvery;      //fields saved every dumpEvery points, 0 none
+  int cleared;        //1 if the bacteria were gone before the last day
+  int resumable;      //1 if 'end.ckpt' can be continued (no rollbacks)
+  std::vector<std::string> files;
+};
+
+/**
+ * 64 bit FNV-1a hash
+ */
+static unsigned long long fnv(const void* data, size_t n, unsigned long long h = 1469598103934665603ULL){
+  const unsigned char* p = (const unsigned char*)data;
+  for(size_t i = 0; i < n; i++){
+    h ^= p[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+static int fileSum(const std::string& fileName, unsigned long long& sum, long long& bytes){
+  FILE* theFile = fopen(fileName.c_str(), "rb");
+  if (theFile==NULL) return 1;
+  unsigned char block[65536];
+  size_t n;
+  sum   = 1469598103934665603ULL;
+  bytes = 0;
+  while((n = fread(block, 1, sizeof(block), theFile)) > 0){
+    sum = fnv(block, n, sum);
+    bytes += n;
+  }
+  fclose(theFile);
+  return 0;
+}
+
+static std::string number(double v){
+  char str[32];
+  snprintf(str, sizeof(str), "%.17g", v);
+  return str;
+}
+
+static void toArray(const IS_Scalars& s, double v[]){
+  v[0] = s.A_T; v[1] = s.MA_T; v[2] = s.MR_T; v[3] = s.F_T;
+  v[4] = s.MA_L; v[5] = s.Th; v[6] = s.B; v[7] = s.P; v[8] = s.F_L;
+}
+
+static void fromArray(const double v[], IS_Scalars& s){
+  s.A_T = v[0]; s.MA_T = v[1]; s.MR_T = v[2]; s.F_T = v[3];
+  s.MA_L = v[4]; s.Th = v[5]; s.B = v[6]; s.P = v[7]; s.F_L = v[8];
+}
+
+static std::string snapshotName(long int t){
+  char str[64];
+  snprintf(str, sizeof(str), "S_%ld.isz", t);
+  return str;
+}
+
+/**
+ * Removes the files of a directory (and the directory if 'all')
+ */
+static void removeFiles(const std::string& path, int all){
+  DIR* d = opendir(path.c_str());
+  if (d==NULL) return;
+  struct dirent* f;
+  while((f = readdir(d)) != NULL){
+    std::string name = f->d_name;
+    if (name != "." && name != "..") unlink((path + name).c_str());
+  }
+  closedir(d);
+  if (all) rmdir(path.c_str());
+}
+
+static int copyFile(const std::string& from, const std::string& to){
+  FILE* in  = fopen(from.c_str(), "rb");
+  FILE* out = fopen(to.c_str(), "wb");
+  unsigned char block[65536];
+  size_t n;
+  int status = (in == NULL || out == NULL);
+  while(!status && (n = fread(block, 1, sizeof(block), in)) > 0){
+    status = fwrite(block, 1, n, out) != n;
+  }
+  if (in) fclose(in);
+  if (out && fclose(out) != 0) status = 1;
+  return status;
+}
+
+static int writeCheckpoint(const std::string& fileName, const IS_Checkpoint& c){
+  FILE* theFile = fopen(fileName.c_str(), "wb");
+  if (theFile==NULL) return 1;
+  double s[SCALARS];
+  long int n = c.fields.size();
+  toArray(c.scalars, s);
+  fwrite(CKPT_MAGIC, 1, 4, theFile);
+  fwrite(&c.t, sizeof(long int), 1, theFile);
+  fwrite(s, sizeof(double), SCALARS, theFile);
+  fwrite(&n, sizeof(long int), 1, theFile);
+  size_t written = fwrite(&c.fields[0], sizeof(double), n, theFile);
+  fclose(theFile);
+  return written != (size_t)n;
+}
+
+static int readCheckpoint(const std::string& fileName, IS_Checkpoint& c){
+  FILE* theFile = fopen(fileName.c_str(), "rb");
+  if (theFile==NULL) return 1;
+  char magic[4];
+  double s[SCALARS];
+  long int n = 0;
+  int status = fread(magic, 1, 4, theFile) != 4 || memcmp(magic, CKPT_MAGIC, 4) != 0
+    || fread(&c.t, sizeof(long int), 1, theFile) != 1
+    || fread(s, sizeof(double), SCALARS, theFile) != (size_t)SCALARS
+    || fread(&n, sizeof(long int), 1, theFile) != 1 || n != IS_SPECIES*SPACE;
+  if (!status){
+    c.fields.resize(n);
+    status = fread(&c.fields[0], sizeof(double), n, theFile) != (size_t)n;
+    fromArray(s, c.scalars);
+  }
+  fclose(theFile);
+  return status;
+}
+
+/**
+ * Reads 'entry.txt' and checks the files of the entry
+ */
+static int readEntry(const std::string& path, const std::string& key, IS_CacheEntry& e){
+  FILE* theFile = fopen((path + "entry.txt").c_str(), "r");
+  if (theFile==NULL) return 1;
+  char name[256], value[256];
+  int status = 0, version = 0;
+  e.key = "";
+  e.records = -1;
+  e.interval = 0;
+  e.dumpEvery = e.cleared = e.resumable = 0;
+  e.files.clear();
+  while(fscanf(theFile, "%255s %255s", name, value) == 2){
+    std::string field = name;
+    if (field == "key") e.key = value;
+    else if (field == "version") version = (std::string(value) == IS_MODEL_VERSION);
+    else if (field == "records") e.records = atol(value);
+    else if (field == "interval") e.interval = atol(value);
+    else if (field == "dumpEvery") e.dumpEvery = atoi(value);
+    else if (field == "cleared") e.cleared = atoi(value);
+    else if (field == "resumable") e.resumable = atoi(value);
+    else if (field == "file"){
+      unsigned long long sum, cachedSum;
+      long long bytes, cachedBytes;
+      if (fscanf(theFile, "%lld %llx", &cachedBytes, &cachedSum) != 2
+          || fileSum(path + value, sum, bytes) || bytes != cachedBytes || sum != cachedSum){
+        status = 1;
+        break;
+      }
+      e.files.push_back(value);
+    }
+  }
+  fclose(theFile);
+  if (status || !version || e.key != key || e.records < 0 || e.interval < 1){
+    cout << "Cache entry " << path << " is not valid, solving again\n";
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Writes 'entry.txt' with the checksums of the entry files
+ */
+static int writeEntry(const std::string& path, const IS_CacheEntry& e){
+  std::string fileName = path + "entry.tmp";
+  FILE* theFile = fopen(fileName.c_str(), "w");
+  if (theFile==NULL){
+    cout << "Error opening file!!!\n Make sure the path is correct! \n";
+    return 1;
+  }
+  fprintf(theFile, "key %s\nversion %s\n", e.key.c_str(), IS_MODEL_VERSION);
+  fprintf(theFile, "records %ld\ninterval %ld\ndumpEvery %d\n", e.records, e.interval, e.dumpEvery);
+  fprintf(theFile, "cleared %d\nresumable %d\n", e.cleared, e.resumable);
+  for(size_t f = 0; f < e.files.size(); f++){
+    unsigned long long sum;
+    long long bytes;
+    if (fileSum(path + e.files[f], sum, bytes)) continue;
+    fprintf(theFile, "file %s %lld %llx\n", e.files[f].c_str(), bytes, sum);
+  }
+  fclose(theFile);
+  return rename(fileName.c_str(), (path + "entry.txt").c_str());
+}
+
+/**
+ * Stores every point of a run in a cache entry, 'suffix' is added to the
+ * names of the series and end state files
+ */
+class IS_CacheRecorder : public IS_Observer{
+
+  private:
+    std::string path;
+    IS_CacheEntry& entry;
+    std::string suffix;
+    FILE* series;
+
+  public:
+    IS_CacheRecorder(const std::string& path, IS_CacheEntry& e, const std::string& suffix = "")
+      : path(path), entry(e), suffix(suffix), series(NULL){}
+    ~IS_CacheRecorder(){ if (series) fclose(series); }
+
+    //continues a copy of the series of the entry
+    int append(){
+      if (copyFile(path + "series.bin", path + "series.bin" + suffix)) return 1;
+      series = fopen((path + "series.bin" + suffix).c_str(), "ab");
+      return series == NULL;
+    }
+
+    int begin(const IS_Model& model){
+      if (series) fclose(series);
+      series = fopen((path + "series.bin" + suffix).c_str(), "wb");
+      entry.records = 0;
+      entry.files.clear();
+      entry.files.push_back("series.bin");
+      return series == NULL;
+    }
+
+    int observe(const IS_Model& model, long int t){
+      double s[SCALARS];
+      toArray(model.getScalars(), s);
+      fwrite(&t, sizeof(long int), 1, series);
+      fwrite(s, sizeof(double), SCALARS, series);
+      if (entry.dumpEvery && entry.records % entry.dumpEvery == 0){
+        double none[IS_SPECIES] = {0.0, 0.0, 0.0, 0.0};
+        std::string name = snapshotName(t);
+        if (IS_WriteSnapshot(path + name, model, t, IS_LOSSLESS, none, none)) return 1;
+        entry.files.push_back(name);
+      }
+      entry.records++;
+      return 0;
+    }
+
+    int end(const IS_Model& model, long int t){
+      IS_Checkpoint c;
+      if (fclose(series) != 0) return 1;
+      series = NULL;
+      model.getCheckpoint(c);
+      entry.cleared   = model.getDay() < model.getConfig().days;
+      entry.resumable = model.getDeltaT() == model.getConfig().deltaT;
+      if (writeCheckpoint(path + "end.ckpt" + suffix, c)) return 1;
+      if (std::find(entry.files.begin(), entry.files.end(), "end.ckpt") == entry.files.end())
+        entry.files.push_back("end.ckpt");
+      return 0;
+    }
+};
+
+IS_Cache::IS_Cache(const std::string& dir, long long maxBytes){
+  this->dir      = dir;
+  this->maxBytes = maxBytes;
+  mkdir(dir.c_str(), 0755);
+}
+
+/**
+ * Hash of everything that defines the solution of a run but its length.
+ * The default interval of the health checks (the snapshot interval)
+ * depends on the length, it is resolved only for rollbacks, the one
+ * policy that changes the solution.
+ */
+std::string IS_Cache::key(const IS_Config& cfg) const{
+  IS_Params<double> par = IS_Model::getParams(cfg);
+  long int healthEvery = cfg.healthEvery;
+  std::ostringstream text;
+  char str[32];
+
+  if (cfg.healthChecks && cfg.healthPolicy == IS_ROLLBACK && healthEvery == 0)
+    healthEvery = ((int)cfg.iterPerDay*cfg.days)/cfg.points;
+
+  text << "version " << IS_MODEL_VERSION << "\n";
+  text << "grid " << Xspace << " " << Yspace << " " << Zspace << " " << buffer << "\n";
+  text << "case " << cfg.simCase << " " << cfg.lnv << " " << cfg.bv << "\n";
+  text << "time " << number(cfg.deltaT) << " " << number(cfg.iterPerDay) << "\n";
+  text << "health " << cfg.healthChecks << " " << cfg.healthPolicy << " "
+       << healthEvery << " " << cfg.healthFused << "\n";
+#define IS_PARAM_KEY(n) text << #n << " " << number(par.n) << "\n";
+  IS_PARAM_LIST(IS_PARAM_KEY)
+#undef IS_PARAM_KEY
+
+  std::string canonical = text.str();
+  snprintf(str, sizeof(str), "%016llx", fnv(canonical.data(), canonical.size()));
+  return str;
+}
+
+/**
+ * Writes the output files of the run of 'model' from every 'every'-th
+ * point of an entry (recorded at a divisor of the interval of the run)
+ */
+int IS_Cache::emit(const IS_Model& model, const std::string& path, long int every){
+  const IS_Config& cfg = model.getConfig();
+  IS_FileObserver files(cfg.dir, cfg.saveFiles, cfg.dumpEvery);
+  files.setCompression(cfg.compress, cfg.absTol, cfg.relTol);
+  int dumpEvery     = (cfg.dumpEvery < 1) ? 1 : cfg.dumpEvery;
+  long int interval = model.getSnapshotInterval();
+  long int steps    = (long int)(cfg.iterPerDay*cfg.days);
+  long int points   = (steps + interval - 1)/interval;
+  long int t = 0;
+
+  FILE* series = fopen((path + "series.bin").c_str(), "rb");
+  if (series==NULL || files.begin(model)){
+    if (series) fclose(series);
+    return 1;
+  }
+  int status = 0;
+  for(long int r = 0, k = 0; k < points && status == 0; r++){
+    double s[SCALARS];
+    IS_Scalars scalars;
+    if (fread(&t, sizeof(long int), 1, series) != 1
+        || fread(s, sizeof(double), SCALARS, series) != (size_t)SCALARS) break;
+    if (r % every != 0) continue;
+    int dump = cfg.saveFiles && (k++ % dumpEvery) == 0;
+    fromArray(s, scalars);
+    status = files.write(t, scalars);
+    if (status || !dump) continue;
+
+    IS_Snapshot snap;
+    status = IS_ReadSnapshot(path + snapshotName(t), snap);
+    if (status) break;
+    status = files.writeFields(t, snap.view());
+  }
+  fclose(series);
+  if (files.end(model, t)) status = 1;
+  return status;
+}
+
+/**
+ * Solves the run defined by cfg, or writes its results from the cache
+ */
+int IS_Cache::solve(const IS_Config& cfg){
+  std::string k    = key(cfg);
+  std::string path = dir + k + "/";
+  IS_Model model(cfg);
+  if (model.reset()) return 1;
+
+  long int interval = model.getSnapshotInterval();
+  long int steps    = (long int)(cfg.iterPerDay*cfg.days);
+  long int points   = (steps + interval - 1)/interval;
+  int dumpEvery     = (cfg.dumpEvery < 1) ? 1 : cfg.dumpEvery;
+  IS_CacheEntry e;
+
+  //the points of the run must be points of the entry, with their fields when saved
+  int found = (readEntry(path, k, e) == 0);
+  found = found && !cfg.analytics && interval % e.interval == 0
+               && (!cfg.saveFiles || (e.dumpEvery > 0
+                                      && (dumpEvery*(interval/e.interval)) % e.dumpEvery == 0));
+
+  //every point is in the cache
+  if (found && (e.cleared || (e.records - 1)*e.interval >= (points - 1)*interval)){
+    utime((path + "entry.txt").c_str(), NULL);
+    cout << "Results read from cache " << path << "\n";
+    return emit(model, path, interval/e.interval);
+  }
+
+  IS_Checkpoint c;
+  int status = 0;
+  mkdir(path.c_str(), 0755);
+
+  if (found && e.resumable && readCheckpoint(path + "end.ckpt", c) == 0){
+    //continue the cached run up to the new last day, at the interval of the entry
+    IS_CacheRecorder recorder(path, e, ".tmp");
+    size_t cached = e.files.size();
+    if (recorder.append() || model.setCheckpoint(c)){
+      unlink((path + "series.bin.tmp").c_str());
+      return 1;
+    }
+    model.addObserver(&recorder, e.interval);
+    IS_Health monitor(cfg.healthChecks, cfg.healthPolicy);
+    if (cfg.healthChecks){
+      model.setHealthMonitor(&monitor, cfg.healthEvery ? cfg.healthEvery : interval,
+                             cfg.healthFused);
+    }
+    cout << "Continuing cached run " << path << " from iteration " << c.t << "\n";
+    while(!model.finished() && status == 0){
+      status = model.step();
+    }
+    if (model.finish()) status = 1;
+    model.setHealthMonitor(NULL, 1);
+    model.removeObserver(&recorder);
+    if (status == 0){
+      status = rename((path + "series.bin.tmp").c_str(), (path + "series.bin").c_str())
+            || rename((path + "end.ckpt.tmp").c_str(), (path + "end.ckpt").c_str())
+            || writeEntry(path, e);
+    }
+    if (status){
+      //back to the cached run (or to an entry that fails its checksums)
+      unlink((path + "series.bin.tmp").c_str());
+      unlink((path + "end.ckpt.tmp").c_str());
+      for(size_t f = cached; f < e.files.size(); f++) unlink((path + e.files[f]).c_str());
+      return 1;
+    }
+    status = emit(model, path, interval/e.interval);
+  } else {
+    //solve from the start
+    IS_CacheRecorder recorder(path, e);
+    removeFiles(path, 0);
+    e.key       = k;
+    e.interval  = interval;
+    e.dumpEvery = cfg.saveFiles ? dumpEvery : 0;
+    model.addObserver(&recorder, interval);
+    status = model.solve();
+    model.removeObserver(&recorder);
+    if (status == 0) status = writeEntry(path, e);
+    if (status){
+      removeFiles(path, 1);
+      return 1;
+    }
+  }
+  evict(k);
+  return status;
+}
+
+/**
+ * Bytes used by the cache
+ */
+long long IS_Cache::size() const{
+  long long total = 0;
+  DIR* d = opendir(dir.c_str());
+  if (d==NULL) return 0;
+  struct dirent* entry;
+  while((entry = readdir(d)) != NULL){
+    std::string path = dir + entry->d_name + "/";
+    if (entry->d_name[0] == '.') continue;
+    DIR* files = opendir(path.c_str());
+    if (files==NULL) continue;
+    struct dirent* f;
+    struct stat st;
+    while((f = readdir(files)) != NULL){
+      if (stat((path + f->d_name).c_str(), &st) == 0 && S_ISREG(st.st_mode)) total += st.st_size;
+    }
+    closedir(files);
+  }
+  closedir(d);
+  return total;
+}
+
+/**
+ * Removes the least recently used entries (but 'keep') until the cache
+ * is below maxBytes
+ */
+int IS_Cache::evict(const std::string& keep){
+  std::vector< std::pair<time_t, size_t> > order; //last use, entry
+  std::vector<std::string> entries;
+  std::vector<long long> bytes;
+  long long total = 0;
+
+  DIR* d = opendir(dir.c_str());
+  if (d==NULL) return 1;
+  struct dirent* entry;
+  while((entry = readdir(d)) != NULL){
+    std::string name = entry->d_name;
+    std::string path = dir + name + "/";
+    struct stat st;
+    if (name[0] == '.' || name == keep) continue;
+    DIR* files = opendir(path.c_str());
+    if (files==NULL) continue;
+    struct dirent* f;
+    long long used = 0;
+    while((f = readdir(files)) != NULL){
+      if (stat((path + f->d_name).c_str(), &st) == 0 && S_ISREG(st.st_mode)) used += st.st_size;
+    }
+    closedir(files);
+    //entries without 'entry.txt' are incomplete and go first
+    time_t last = (stat((path + "entry.txt").c_str(), &st) == 0) ? st.st_mtime : 0;
+    order.push_back(std::make_pair(last, entries.size()));
+    entries.push_back(path);
+    bytes.push_back(used);
+  }
+  closedir(d);
+
+  total = size();
+  std::sort(order.begin(), order.end());
+  for(size_t i = 0; i < order.size() && total > maxBytes; i++){
+    removeFiles(entries[order[i].second], 1);
+    total -= bytes[order[i].second];
+  }
+  return 0;
+}
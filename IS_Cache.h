@@ -0,0 +1,42 @@
+#ifndef _IS_Cache_H_
+#define _IS_Cache_H_
+
+#include "IS_Model.h"
+
+/**
+ * Content addressed cache of the results of IS_Model.
+ *
+ * The key of a run hashes everything that changes its solution:
+ * IS_MODEL_VERSION, the grid, simCase, lnv, bv, deltaT, iterPerDay, the
+ * health settings and every parameter of IS_PARAM_LIST, but not the
+ * number of days. The entry 'dir/<key>/' keeps the time series of every
+ * point, the fields (lossless '.isz') when they were saved and the end
+ * state of the run, with the snapshot interval they were recorded at, so
+ *   - a run found in the cache only writes its output files,
+ *   - a run with more days continues from the cached end state,
+ *   - any other run (analytics, fields not cached, snapshot interval not
+ *     a multiple of the cached one) is solved again.
+ * The files of an entry are checked against their checksums before use,
+ * and the least recently used entries are removed above 'maxBytes'.
+ * Runs with different numbers of OpenMP threads share the entries, their
+ * results differ only by the rounding of the reductions.
+ */
+class IS_Cache{
+
+  private:
+
+    std::string dir;
+    long long maxBytes;
+
+    int emit(const IS_Model& model, const std::string& path, long int every);
+
+  public:
+    IS_Cache(const std::string& dir, long long maxBytes = 1LL << 30);
+    std::string key(const IS_Config& cfg) const;
+    int solve(const IS_Config& cfg);
+    long long size() const;
+    int evict(const std::string& keep = "");
+
+};
+
+#endif
@@ -0,0 +1,310 @@
+#include "IS_Compress.h"
+#include <string.h>
+#include <stdint.h>
+#include <zlib.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/******************************************************************************
+ * 
+ * IS_Compress - compressed field snapshots ('.isz' files).
+ * 
+ * Each species is split in chunks of x planes and each chunk is encoded
+ * independently (so chunks are compressed and decompressed in parallel):
+ * 
+ *   1. lossy mode only: values quantized to q = round(v/(2*eps)),
+ *      so the reconstructed value is within eps of the original;
+ *   2. delta of consecutive 64 bit words (bit patterns of the doubles in
+ *      lossless mode), zigzag encoded;
+ *   3. byte-shuffle, grouping the n-th byte of every word;
+ *   4. zlib.
+ * 
+ * File layout (native byte order):
+ *   "ISZ1", int X, Y, Z, species, long t,
+ *   per species: int mode, double eps, int chunks,
+ *                per chunk: uint64 raw bytes, uint64 compressed bytes, data.
+ * 
+ * Recquires: zlib (link with -lz), OpenMP is optional.
+ * 
+ ******************************************************************************/
+
+using namespace std;
+
+static const char   ISZ_MAGIC[4]   = {'I','S','Z','1'};
+static const size_t MIN_CHUNK_VALUES = 4096; //smaller chunks compress poorly
+
+/**
+ * Number of x planes in each chunk: one chunk per thread and species, so
+ * IS_SPECIES*min(threads, X) chunks are encoded in parallel (e.g. 64 on a
+ * 128^3 grid with 16 threads), unless the chunks would get smaller than
+ * MIN_CHUNK_VALUES. On the default 10^3 grid every species is a single
+ * chunk and only the IS_SPECIES species run in parallel.
+ */
+static int chunkPlanes(int X, int Y, int Z){
+  int threads = 1;
+#ifdef _OPENMP
+  threads = omp_get_max_threads();
+#endif
+  int planes    = (X + threads - 1)/threads;
+  int minPlanes = (int)((MIN_CHUNK_VALUES + Y*Z - 1)/(Y*Z));
+  if (planes < minPlanes) planes = minPlanes;
+  return (planes > X) ? X : planes;
+}
+
+/**
+ * Encodes n values, eps = 0 means lossless
+ */
+static int encodeChunk(const double* v, size_t n, double eps, vector<unsigned char>& out){
+  vector<unsigned char> shuffled(n*8);
+  uint64_t prev = 0;
+
+  for(size_t i = 0; i < n; i++){
+    uint64_t cur;
+    if (eps > 0.0){
+      int64_t q = llround(v[i]/(2*eps));
+      cur = (uint64_t)q;
+    } else {
+      memcpy(&cur, &v[i], 8);
+    }
+    int64_t d  = (int64_t)(cur - prev);
+    uint64_t w = ((uint64_t)d << 1) ^ (uint64_t)(d >> 63);
+    prev = cur;
+    for(int b = 0; b < 8; b++) shuffled[b*n + i] = (unsigned char)(w >> (8*b));
+  }
+
+  uLongf size = compressBound(shuffled.size());
+  out.resize(size);
+  if (compress2(&out[0], &size, &shuffled[0], shuffled.size(), Z_DEFAULT_COMPRESSION) != Z_OK)
+    return 1;
+  out.resize(size);
+  return 0;
+}
+
+/**
+ * Decodes n values written by encodeChunk
+ */
+static int decodeChunk(const unsigned char* in, size_t inSize, size_t n, double eps, double* v){
+  vector<unsigned char> shuffled(n*8);
+  uLongf size = shuffled.size();
+  uint64_t prev = 0;
+
+  if (uncompress(&shuffled[0], &size, in, inSize) != Z_OK || size != n*8) return 1;
+
+  for(size_t i = 0; i < n; i++){
+    uint64_t w = 0;
+    for(int b = 0; b < 8; b++) w |= (uint64_t)shuffled[b*n + i] << (8*b);
+    int64_t d  = (int64_t)((w >> 1) ^ (~(w & 1) + 1));
+    uint64_t cur = prev + (uint64_t)d;
+    prev = cur;
+    if (eps > 0.0){
+      v[i] = (double)(int64_t)cur*(2*eps);
+    } else {
+      memcpy(&v[i], &cur, 8);
+    }
+  }
+  return 0;
+}
+
+/**
+ * Quantization step of a species, 0 when it must be stored without loss
+ */
+static double speciesError(const IS_View& u, int s, double absTol, double relTol){
+  double maxV = 0.0;
+  for(int x = 0; x < Xspace; x++)
+    for(int y = 0; y < Yspace; y++)
+      for(int z = 0; z < Zspace; z++){
+        double v = u(s,x,y,z);
+        if (!isfinite(v)) return 0.0;
+        if (fabs(v) > maxV) maxV = fabs(v);
+      }
+  double eps = (absTol > 0.0) ? absTol : relTol*maxV;
+  //quantized values must fit in 62 bits after the delta
+  if (eps <= 0.0 || maxV/(2*eps) > pow(2.0,60)) return 0.0;
+  return eps;
+}
+
+int IS_WriteSnapshot(const std::string& fileName, const IS_Model& model, long int t,
+                     int mode, const double absTol[], const double relTol[]){
+  return IS_WriteSnapshot(fileName, model.getFields(), t, mode, absTol, relTol);
+}
+
+int IS_WriteSnapshot(const std::string& fileName, const IS_View& u, long int t,
+                     int mode, const double absTol[], const double relTol[]){
+  const size_t plane = Yspace*Zspace;
+  int planes  = chunkPlanes(Xspace, Yspace, Zspace);
+  int nchunks = (Xspace + planes - 1)/planes;
+  double eps[IS_SPECIES];
+  vector< vector<unsigned char> > data(IS_SPECIES*nchunks);
+  int failed = 0;
+
+  for(int s = 0; s < IS_SPECIES; s++){
+    eps[s] = (mode == IS_LOSSY) ? speciesError(u, s, absTol[s], relTol[s]) : 0.0;
+  }
+
+  #pragma omp parallel for schedule(dynamic) reduction(+:failed)
+  for(int k = 0; k < IS_SPECIES*nchunks; k++){
+    int s  = k/nchunks;
+    int x0 = (k%nchunks)*planes;
+    int x1 = (x0 + planes < Xspace) ? x0 + planes : Xspace;
+    //the planes of the chunk in [x][y][z] order (in place for IS_SOA)
+    vector<double> copy;
+    const double* v;
+    if (u.layout == IS_SOA){
+      v = &u.soa.f[s][0][x0][0][0];
+    } else {
+      copy.resize((x1-x0)*plane);
+      for(int x = x0; x < x1; x++)
+        for(int y = 0; y < Yspace; y++)
+          for(int z = 0; z < Zspace; z++) copy[((x-x0)*Yspace + y)*Zspace + z] = u(s,x,y,z);
+      v = &copy[0];
+    }
+    failed += encodeChunk(v, (x1-x0)*plane, eps[s], data[k]);
+  }
+  if (failed){
+    cout << "Error compressing snapshot " << fileName << "\n";
+    return 1;
+  }
+
+  FILE* theFile = fopen(fileName.c_str(), "wb");
+  if (theFile==NULL){
+    cout << "Error opening file!!!\n Make sure the path is correct! \n";
+    return 1;
+  }
+  int header[4] = {Xspace, Yspace, Zspace, IS_SPECIES};
+  fwrite(ISZ_MAGIC, 1, 4, theFile);
+  fwrite(header, sizeof(int), 4, theFile);
+  fwrite(&t, sizeof(long int), 1, theFile);
+  for(int s = 0; s < IS_SPECIES; s++){
+    int smode = (eps[s] > 0.0) ? IS_LOSSY : IS_LOSSLESS;
+    fwrite(&smode, sizeof(int), 1, theFile);
+    fwrite(&eps[s], sizeof(double), 1, theFile);
+    fwrite(&nchunks, sizeof(int), 1, theFile);
+    for(int c = 0; c < nchunks; c++){
+      int k = s*nchunks + c;
+      int x0 = c*planes;
+      int x1 = (x0 + planes < Xspace) ? x0 + planes : Xspace;
+      uint64_t sizes[2] = {(uint64_t)((x1-x0)*plane*8), (uint64_t)data[k].size()};
+      fwrite(sizes, sizeof(uint64_t), 2, theFile);
+      fwrite(&data[k][0], 1, data[k].size(), theFile);
+    }
+  }
+  int error = ferror(theFile);
+  fclose(theFile);
+  return error ? 1 : 0;
+}
+
+IS_View IS_Snapshot::view() const{
+  IS_View u;
+  u.layout     = IS_SOA;
+  u.aosoa.data = NULL;
+  for(int s = 0; s < IS_SPECIES; s++) u.soa.f[s] = (double (*)[Xspace][Yspace][Zspace])&field[s][0];
+  return u;
+}
+
+int IS_ReadSnapshot(const std::string& fileName, IS_Snapshot& snap){
+  char magic[4];
+  int header[4];
+  long fileSize;
+  vector<unsigned char> data;
+  vector<size_t> offset, rawSize, compSize;
+
+  FILE* theFile = fopen(fileName.c_str(), "rb");
+  if (theFile==NULL){
+    cout << "Error opening file " << fileName << "\n";
+    return 1;
+  }
+  fseek(theFile, 0, SEEK_END);
+  fileSize = ftell(theFile);
+  rewind(theFile);
+  if (fread(magic, 1, 4, theFile) != 4 || memcmp(magic, ISZ_MAGIC, 4) != 0
+      || fread(header, sizeof(int), 4, theFile) != 4 || header[3] != IS_SPECIES
+      || fread(&snap.t, sizeof(long int), 1, theFile) != 1){
+    cout << "Not a snapshot file : " << fileName << "\n";
+    fclose(theFile);
+    return 1;
+  }
+  //check the header before allocating anything (zlib never compresses more than 1032:1)
+  if (header[0] < 1 || header[1] < 1 || header[2] < 1
+      || 8.0*header[0]*header[1]*header[2] > 1032.0*fileSize){
+    cout << "Invalid grid " << header[0] << "x" << header[1] << "x" << header[2]
+         << " in snapshot : " << fileName << "\n";
+    fclose(theFile);
+    return 1;
+  }
+  snap.X = header[0];
+  snap.Y = header[1];
+  snap.Z = header[2];
+  size_t n = (size_t)snap.X*snap.Y*snap.Z;
+
+  for(int s = 0; s < IS_SPECIES; s++){
+    int smode, nchunks;
+    if (fread(&smode, sizeof(int), 1, theFile) != 1
+        || fread(&snap.error[s], sizeof(double), 1, theFile) != 1
+        || fread(&nchunks, sizeof(int), 1, theFile) != 1){
+      cout << "Truncated snapshot : " << fileName << "\n";
+      fclose(theFile);
+      return 1;
+    }
+    if (nchunks < 1 || nchunks > snap.X || (smode != IS_LOSSLESS && smode != IS_LOSSY)
+        || !(snap.error[s] >= 0.0)){
+      cout << "Invalid header of species " << s << " in snapshot : " << fileName << "\n";
+      fclose(theFile);
+      return 1;
+    }
+    if (smode == IS_LOSSLESS) snap.error[s] = 0.0;
+
+    //read every chunk, then decode them in parallel
+    data.clear(); offset.clear(); rawSize.clear(); compSize.clear();
+    size_t total = 0;
+    for(int c = 0; c < nchunks; c++){
+      uint64_t sizes[2];
+      if (fread(sizes, sizeof(uint64_t), 2, theFile) != 2){
+        cout << "Truncated snapshot : " << fileName << "\n";
+        fclose(theFile);
+        return 1;
+      }
+      long remaining = fileSize - ftell(theFile);
+      if (sizes[0] == 0 || sizes[0] % 8 != 0 || sizes[0]/8 > n - total
+          || sizes[1] == 0 || sizes[1] > (uint64_t)remaining){
+        cout << "Invalid chunk " << c << " of species " << s << " in snapshot : " << fileName << "\n";
+        fclose(theFile);
+        return 1;
+      }
+      total += sizes[0]/8;
+      offset.push_back(data.size());
+      rawSize.push_back(sizes[0]);
+      compSize.push_back(sizes[1]);
+      data.resize(data.size() + sizes[1]);
+      if (fread(&data[offset[c]], 1, sizes[1], theFile) != sizes[1]){
+        cout << "Truncated snapshot : " << fileName << "\n";
+        fclose(theFile);
+        return 1;
+      }
+    }
+    if (total != n){
+      cout << "Chunks do not cover the grid in snapshot : " << fileName << "\n";
+      fclose(theFile);
+      return 1;
+    }
+    snap.field[s].resize(n);
+
+    vector<size_t> start(nchunks+1, 0);
+    for(int c = 0; c < nchunks; c++) start[c+1] = start[c] + rawSize[c]/8;
+
+    int failed = 0;
+    double eps = snap.error[s];
+    #pragma omp parallel for schedule(dynamic) reduction(+:failed)
+    for(int c = 0; c < nchunks; c++){
+      failed += decodeChunk(&data[offset[c]], compSize[c], rawSize[c]/8, eps,
+                            &snap.field[s][start[c]]);
+    }
+    if (failed){
+      cout << "Corrupted snapshot : " << fileName << "\n";
+      fclose(theFile);
+      return 1;
+    }
+  }
+  fclose(theFile);
+  return 0;
+}
@@ -0,0 +1,41 @@
+#ifndef _IS_Compress_H_
+#define _IS_Compress_H_
+
+#include "IS_Model.h"
+
+/**
+ * Compression modes of the field snapshots
+ */
+const int IS_CSV      = 0; //text files, one per species
+const int IS_LOSSLESS = 1; //delta + byte-shuffle + zlib
+const int IS_LOSSY    = 2; //quantization to a given error + delta + byte-shuffle + zlib
+
+/**
+ * Fields read back from a '.isz' snapshot, stored as [x][y][z]
+ */
+struct IS_Snapshot{
+  long int t;
+  int X, Y, Z;
+  std::vector<double> field[IS_SPECIES]; //A, MR, MA, F
+  double error[IS_SPECIES];              //maximum absolute error (0 if lossless)
+
+  double at(int s, int x, int y, int z) const { return field[s][(x*Y + y)*Z + z]; }
+  IS_View view() const; //the fields as an IS_View, on the grid of IS_Model only
+};
+
+/**
+ * Writes the four fields of the model (or of a view) in a single compressed file.
+ * The fields are split in chunks of x planes compressed in parallel.
+ * absTol/relTol give the error of each species in lossy mode.
+ */
+int IS_WriteSnapshot(const std::string& fileName, const IS_Model& model, long int t,
+                     int mode, const double absTol[], const double relTol[]);
+int IS_WriteSnapshot(const std::string& fileName, const IS_View& u, long int t,
+                     int mode, const double absTol[], const double relTol[]);
+
+/**
+ * Reads a file written by IS_WriteSnapshot
+ */
+int IS_ReadSnapshot(const std::string& fileName, IS_Snapshot& snap);
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef _IS_Dual_H_
+#define _IS_Dual_H_
+
+/******************************************************************************
+ * 
+ * IS_Dual - dual number for forward mode derivatives.
+ * 
+ * Carries a value and its derivatives with respect to IS_LANES parameters.
+ * The lanes are a fixed size array so the loops over them are vectorized.
+ * 
+ ******************************************************************************/
+
+const int IS_LANES = 8; //maximum number of parameters in one run
+
+struct IS_Dual{
+  double v;
+  double d[IS_LANES];
+
+  IS_Dual(){}
+  IS_Dual(double value){
+    v = value;
+    #pragma omp simd
+    for(int i = 0; i < IS_LANES; i++) d[i] = 0.0;
+  }
+};
+
+inline IS_Dual operator-(const IS_Dual& a){
+  IS_Dual r;
+  r.v = -a.v;
+  #pragma omp simd
+  for(int i = 0; i < IS_LANES; i++) r.d[i] = -a.d[i];
+  return r;
+}
+
+inline IS_Dual operator+(const IS_Dual& a, const IS_Dual& b){
+  IS_Dual r;
+  r.v = a.v + b.v;
+  #pragma omp simd
+  for(int i = 0; i < IS_LANES; i++) r.d[i] = a.d[i] + b.d[i];
+  return r;
+}
+
+inline IS_Dual operator-(const IS_Dual& a, const IS_Dual& b){
+  IS_Dual r;
+  r.v = a.v - b.v;
+  #pragma omp simd
+  for(int i = 0; i < IS_LANES; i++) r.d[i] = a.d[i] - b.d[i];
+  return r;
+}
+
+inline IS_Dual operator*(const IS_Dual& a, const IS_Dual& b){
+  IS_Dual r;
+  r.v = a.v * b.v;
+  #pragma omp simd
+  for(int i = 0; i < IS_LANES; i++) r.d[i] = a.d[i]*b.v + a.v*b.d[i];
+  return r;
+}
+
+inline IS_Dual operator/(const IS_Dual& a, const IS_Dual& b){
+  IS_Dual r;
+  double inv = 1.0/b.v;
+  r.v = a.v * inv;
+  #pragma omp simd
+  for(int i = 0; i < IS_LANES; i++) r.d[i] = (a.d[i] - r.v*b.d[i])*inv;
+  return r;
+}
+
+/**
+ * Operations with constants (no derivative)
+ */
+inline IS_Dual operator+(const IS_Dual& a, double b){
+  IS_Dual r = a;
+  r.v += b;
+  return r;
+}
+inline IS_Dual operator+(double a, const IS_Dual& b){ return b + a; }
+
+inline IS_Dual operator-(const IS_Dual& a, double b){ return a + (-b); }
+inline IS_Dual operator-(double a, const IS_Dual& b){
+  IS_Dual r = -b;
+  r.v += a;
+  return r;
+}
+
+inline IS_Dual operator*(const IS_Dual& a, double b){
+  IS_Dual r;
+  r.v = a.v * b;
+  #pragma omp simd
+  for(int i = 0; i < IS_LANES; i++) r.d[i] = a.d[i]*b;
+  return r;
+}
+inline IS_Dual operator*(double a, const IS_Dual& b){ return b * a; }
+
+inline IS_Dual operator/(const IS_Dual& a, double b){
+  IS_Dual r;
+  r.v = a.v / b;
+  #pragma omp simd
+  for(int i = 0; i < IS_LANES; i++) r.d[i] = a.d[i]/b;
+  return r;
+}
+inline IS_Dual operator/(double a, const IS_Dual& b){ return IS_Dual(a)/b; }
+
+inline IS_Dual& operator+=(IS_Dual& a, const IS_Dual& b){ a = a + b; return a; }
+
+/**
+ * Comparisons use only the value
+ */
+inline bool operator<(const IS_Dual& a, double b){ return a.v < b; }
+inline bool operator>(const IS_Dual& a, double b){ return a.v > b; }
+
+#endif
@@ -0,0 +1,212 @@
+#ifndef _IS_Equations_H_
+#define _IS_Equations_H_
+
+/******************************************************************************
+ * 
+ * IS_Equations - model equations written for any scalar type T.
+ * 
+ * Used by IS_Model with T = double and by IS_Sensitivity with T = IS_Dual,
+ * so both solve exactly the same equations.
+ * 
+ ******************************************************************************/
+
+/**
+ * Parameters of the model, as set in IS_Model::initialize()
+ */
+#define IS_PARAM_LIST(X)                                                    \
+  X(a0) X(m0) X(f0) X(th0) X(b0) X(p0)                                      \
+  X(t_estrela) X(b_estrela) X(p_estrela) X(f_estrela) X(m_estrela)          \
+  X(d_a) X(d_mr) X(d_ma) X(d_f)                                             \
+  X(beta_A) X(k_A) X(m_A) X(m_Mr) X(m_Ma) X(gamma_ma)                       \
+  X(lambda_mr) X(lambda_ma) X(lambda_afmr) X(lambda_afma)                   \
+  X(b_th) X(b_p) X(b_pb) X(b_pp) X(ro_t) X(ro_b) X(ro_p) X(ro_f)            \
+  X(alpha_Ma) X(alpha_t) X(alpha_b) X(alpha_p) X(alpha_f) X(alpha_mr)
+
+template<class T>
+struct IS_Params{
+#define IS_PARAM_MEMBER(n) T n;
+  IS_PARAM_LIST(IS_PARAM_MEMBER)
+#undef IS_PARAM_MEMBER
+};
+
+/**
+ * Returns the parameter with the given name (NULL if there is none)
+ */
+template<class T>
+T* IS_ParamByName(IS_Params<T>& p, const std::string& name){
+#define IS_PARAM_NAME(n) if (name == #n) return &p.n;
+  IS_PARAM_LIST(IS_PARAM_NAME)
+#undef IS_PARAM_NAME
+  return NULL;
+}
+
+/**
+ * Initial Conditions of point x,y,z
+ */
+template<class T>
+void IS_InitialPoint(const IS_Params<T>& p, int simCase, int x, int y, int z,
+                     T& A, T& MR, T& MA, T& F){
+  if (simCase == 3){ //no diffusion
+    A = p.a0;
+  }else{
+    //bacteria only in the center of the cubic domain
+    if ((x > (0.2*Xspace)&&( x < (0.7*Xspace)))
+      && (y > (0.2*Yspace)&&( y < (0.7*Yspace)))
+      && (z > (0.2*Zspace)&&( z < (0.7*Zspace)))) {
+      A = p.a0;///IC_SPACE;
+    } else {
+      A = 0.0;
+    }
+  }
+  MR  = p.m_estrela;
+  MA  = 0.0;
+  F   = p.f0;//SPACE;
+}
+
+/**
+ * Initial Conditions
+ */
+template<class T>
+void IS_InitialConditions(const IS_Params<T>& p, int simCase, T A[][Yspace][Zspace],
+                          T MR[][Yspace][Zspace], T MA[][Yspace][Zspace], T F[][Yspace][Zspace]){
+  for(int x = 0; x < Xspace; x++) {
+    for(int y = 0; y < Yspace; y++) {
+      for(int z = 0; z < Zspace; z++) {
+        IS_InitialPoint(p, simCase, x, y, z, A[x][y][z], MR[x][y][z], MA[x][y][z], F[x][y][z]);
+      }
+    }
+  }
+}
+
+/**
+ * Calculates the laplacian at a given position of the field vec(x,y,z)
+ * (see IS_Layout.h)
+ */
+template<class T, class V>
+inline T IS_LaplacianAt(const V& vec, int x, int y, int z,
+                        double deltaX, double deltaY, double deltaZ){
+  T resX, resY, resZ;
+  // same boundary condition to every equation
+  if(x == 0) {
+    resX = (vec(x+1,y,z) - vec(x,y,z))/(deltaX*deltaX);
+  } else if(x == Xspace-1 ) {
+    resX = (vec(x-1,y,z) - vec(x,y,z))/(deltaX*deltaX);
+  } else {//dentro do dominio mas fora da extremidade
+    resX = (vec(x+1,y,z) -2 * vec(x,y,z) + vec(x-1,y,z))/(deltaX*deltaX);
+  }
+  if(y == 0) {
+    resY = (vec(x,y+1,z) - vec(x,y,z))/(deltaY*deltaY);
+  } else if( y == Yspace-1) {
+    resY = (vec(x,y-1,z) - vec(x,y,z))/(deltaY*deltaY);
+  } else {
+    resY = (vec(x,y+1,z) -2 * vec(x,y,z) + vec(x,y-1,z))/(deltaY*deltaY);
+  }
+  if(z == 0) {
+    resZ = (vec(x,y,z+1) - vec(x,y,z))/(deltaZ*deltaZ);
+  } else if( z == Zspace-1) {
+    resZ = (vec(x,y,z-1) - vec(x,y,z))/(deltaZ*deltaZ);
+  } else {
+    resZ = (vec(x,y,z+1) -2 * vec(x,y,z) + vec(x,y,z-1))/(deltaZ*deltaZ);
+  }
+  return resX+resY+resZ;
+}
+
+/**
+ * Array with the same call syntax
+ */
+template<class T>
+struct IS_ArrayAt{
+  const T (*vec)[Yspace][Zspace];
+
+  inline const T& operator()(int x, int y, int z) const { return vec[x][y][z]; }
+};
+
+/**
+ * Calculates the laplacian for given value and position
+ */
+template<class T>
+inline T IS_Laplacian(const T vec[][Yspace][Zspace], int x, int y, int z,
+                      double deltaX, double deltaY, double deltaZ){
+  IS_ArrayAt<T> at = {vec};
+  return IS_LaplacianAt<T>(at, x, y, z, deltaX, deltaY, deltaZ);
+}
+
+/**
+ * Lymph node ODEs, one time step
+ */
+template<class T>
+inline void IS_LymphNode(const IS_Params<T>& p, double deltaT, const T& MA_T, const T& F_T,
+                         T& MA_L, T& Th, T& B, T& P, T& F_L){
+  MA_L = ( p.alpha_Ma * (MA_T - MA_L)) * deltaT + MA_L;
+  if (MA_L < 0.0) MA_L = 0.0;
+
+  Th = (p.b_th*(p.ro_t*Th*MA_L -Th*MA_L) -p.b_p*MA_L*Th*B
+    + p.alpha_t*(p.t_estrela - Th)) * deltaT + Th;
+  if (Th < 0.0) Th = p.t_estrela;
+
+  B = (p.b_pb*(p.ro_b*Th*MA_L-Th*MA_L*B)
+     + p.alpha_b*(p.b_estrela - B)) * deltaT + B;
+  if (B < 0.0) B = p.b_estrela;
+
+  P = (p.b_pp*(p.ro_p*Th*MA_L*B) + p.alpha_p*(p.p_estrela - P)) * deltaT + P;
+  if (P < 0.0) P = p.p_estrela;
+
+  F_L = (p.ro_f*P + p.alpha_f*(F_T-F_L)) * deltaT + F_L;
+  if (F_L < 0.0) F_L = p.f_estrela;
+}
+
+/**
+ * Complete model (simCase 0), one time step of one point.
+ * blood/lymph tell if the point is in contact with blood/lymph vessels.
+ */
+template<class T>
+inline void IS_CoupledPoint(const IS_Params<T>& p, double deltaT, double tol,
+                            const T& A, const T& MR, const T& MA, const T& F,
+                            const T& lapA, const T& lapMR, const T& lapMA, const T& lapF,
+                            int blood, int lymph, const T& MA_T, const T& MA_L,
+                            const T& F_T, const T& F_L,
+                            T& A1, T& MR1, T& MA1, T& F1){
+  //Antigenos
+  A1 = ( p.beta_A*A*(1-(A/p.k_A))
+    - ( p.lambda_mr*MR*A)
+    - ( p.lambda_ma * MA * A)
+    - ( p.lambda_afma*F*A*MA)
+    - ( p.lambda_afmr*F*A*MR)
+    - p.m_A * A
+    + (p.d_a * lapA)
+    ) * deltaT + A;
+
+  if(A1 < tol) {A1 = 0.0;}
+
+  //Macrophages
+  T source_mr = 0.0;
+  if (blood)
+    source_mr = p.alpha_mr * (p.m_estrela - MR);
+
+  MR1 = ((- p.m_Mr * MR)
+    - (p.gamma_ma * MR * A)
+    + (p.d_mr * lapMR)
+    + source_mr ) * deltaT + MR;
+
+  T migration_ma = 0.0; //migração macrófagos
+  if (lymph)
+    migration_ma = p.alpha_Ma * (MA_T - MA_L);
+
+  MA1 = ((-p.m_Ma * MA)
+    + (p.gamma_ma * MR * A)
+    + (p.d_ma * lapMA)
+    - migration_ma ) * deltaT + MA;
+
+  //Antibody
+  T migration_f = 0.0;  //migração antigens
+  if (blood)
+    migration_f = (p.alpha_f * (F_T - F_L));
+
+  F1 = (
+    - ( p.lambda_afma * F * A*MA)
+    - ( p.lambda_afmr*F*A*MR)
+    - migration_f + (p.d_f * lapF)
+    )* deltaT + F;
+}
+
+#endif
@@ -0,0 +1,171 @@
+#include "IS_FileObserver.h"
+#include "IS_Compress.h"
+
+/******************************************************************************
+ * 
+ * IS_FileObserver - writes the results of IS_Model to text files.
+ * 
+ * Registered by IS_Model::solve() every getSnapshotInterval() time steps,
+ * it can also be registered by hand when driving the model step by step.
+ * 
+ ******************************************************************************/
+
+using namespace std;
+
+IS_FileObserver::IS_FileObserver(const std::string& dir, int saveFiles, int dumpEvery){
+  this->dir       = dir;
+  this->saveFiles = saveFiles;
+  this->dumpEvery = (dumpEvery < 1) ? 1 : dumpEvery;
+  this->calls     = 0;
+  this->compress  = IS_CSV;
+  datamatlabL = datamatlabT = datamatlabB = datamatlabP = NULL;
+}
+
+IS_FileObserver::~IS_FileObserver(){
+  close();
+}
+
+/**
+ * Fields saved compressed, tolerances are used only in lossy mode
+ */
+void IS_FileObserver::setCompression(int mode, const double absTol[], const double relTol[]){
+  this->compress = mode;
+  for(int s = 0; s < IS_SPECIES; s++){
+    this->absTol[s] = absTol[s];
+    this->relTol[s] = relTol[s];
+  }
+}
+
+/**
+ * Tests if the file could be created and exits the simulation if
+ * there was an error
+ */
+int IS_FileObserver::checkFile(FILE* theFile){
+  if (theFile==NULL){
+    cout << "Error opening file!!!\n Make sure the path is correct! \n";
+    return 1;
+  }
+  return 0;
+}
+
+void IS_FileObserver::close(){
+  if (datamatlabL) fclose(datamatlabL);
+  if (datamatlabT) fclose(datamatlabT);
+  if (datamatlabB) fclose(datamatlabB);
+  if (datamatlabP) fclose(datamatlabP);
+  datamatlabL = datamatlabT = datamatlabB = datamatlabP = NULL;
+}
+
+/**
+ * Opens the time series files
+ */
+int IS_FileObserver::begin(const IS_Model& model){
+  string fileName;
+
+  close();
+  calls = 0;
+
+  fileName = dir + "L.dat";
+  datamatlabL = fopen(fileName.c_str(), "w");
+
+  //check valid dir
+  if (checkFile(datamatlabL)){
+    close();
+    return 1;
+  }
+
+  fileName = dir + "T.dat";
+  datamatlabT = fopen(fileName.c_str(), "w");
+
+  fileName = dir + "B.dat";
+  datamatlabB = fopen(fileName.c_str(), "w");
+
+  fileName = dir + "P.dat";
+  datamatlabP = fopen(fileName.c_str(), "w");
+
+  if (checkFile(datamatlabT) || checkFile(datamatlabB) || checkFile(datamatlabP)){
+    close();
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Saves the time series values and, if requested, the fields
+ */
+int IS_FileObserver::observe(const IS_Model& model, long int t){
+  cout << "Saving files : iteration ..."<< t << "\n";
+
+  if (write(t, model.getScalars())) return 1;
+  if (!saveFiles || (calls++ % dumpEvery) != 0) return 0;
+  return writeFields(t, model.getFields());
+}
+
+/**
+ * Appends one line to the time series files
+ */
+int IS_FileObserver::write(long int t, const IS_Scalars& s){
+  if (checkFile(datamatlabL)) return 1;
+  fprintf(datamatlabT, "%ld %.2E \n", t, s.Th);
+  fprintf(datamatlabB, "%ld %.2E \n", t, s.B);
+  fprintf(datamatlabP, "%ld %.2E \n", t, s.P);
+  fprintf(datamatlabL, "%ld %.2E %.2E %.2E %.2E %.2E %.2E\n", t, s.MA_T, s.F_T, s.MA_L, s.F_L, s.A_T, s.MR_T);
+  return 0;
+}
+
+/**
+ * Saves the fields A, MR, MA and F of time step t
+ */
+int IS_FileObserver::writeFields(long int t, const IS_View& u){
+  char fileName[512];
+
+  if (compress != IS_CSV){
+    snprintf(fileName, sizeof(fileName), "%sS_%ld.isz", dir.c_str(), t);
+    return IS_WriteSnapshot(fileName, u, t, compress, absTol, relTol);
+  }
+
+  snprintf(fileName, sizeof(fileName), "%sA_%ld.csv", dir.c_str(), t);
+  datamatlabA = fopen(fileName, "w");
+  snprintf(fileName, sizeof(fileName), "%sMr_%ld.csv", dir.c_str(), t);
+  datamatlabMr = fopen(fileName, "w");
+  snprintf(fileName, sizeof(fileName), "%sMa_%ld.csv", dir.c_str(), t);
+  datamatlabMa = fopen(fileName, "w");
+  snprintf(fileName, sizeof(fileName), "%sF_%ld.csv", dir.c_str(), t);
+  datamatlabF = fopen(fileName, "w");
+  if (checkFile(datamatlabA) || checkFile(datamatlabMr)
+      || checkFile(datamatlabMa) || checkFile(datamatlabF)){
+    if (datamatlabA) fclose(datamatlabA);
+    if (datamatlabMr) fclose(datamatlabMr);
+    if (datamatlabMa) fclose(datamatlabMa);
+    if (datamatlabF) fclose(datamatlabF);
+    return 1;
+  }
+
+  for(int x = 0; x < Xspace; x++) {
+    for(int y = 0; y < Yspace; y++) {
+      for(int z = 0; z < Zspace; z++) {
+        if( (x+1 == Xspace && y+1 == Yspace && z+1==Zspace) ) {
+          fprintf(datamatlabA, "%d %d %d %E", x, y, z, u(0,x,y,z));
+          fprintf(datamatlabMr, "%d %d %d %E", x, y, z, u(1,x,y,z));
+          fprintf(datamatlabMa, "%d %d %d %E", x, y, z, u(2,x,y,z));
+          fprintf(datamatlabF, "%d %d %d %E", x, y, z, u(3,x,y,z));
+        } else {
+          fprintf(datamatlabA, "%d %d %d %E\n", x, y, z, u(0,x,y,z));
+          fprintf(datamatlabMr, "%d %d %d %E\n", x, y, z, u(1,x,y,z));
+          fprintf(datamatlabMa, "%d %d %d %E\n", x, y, z, u(2,x,y,z));
+          fprintf(datamatlabF, "%d %d %d %E\n", x, y, z, u(3,x,y,z));
+        }
+      }
+    }
+  }
+  fclose(datamatlabA);
+  fclose(datamatlabMr);
+  fclose(datamatlabMa);
+  fclose(datamatlabF);
+  return 0;
+}
+
+int IS_FileObserver::end(const IS_Model& model, long int t){
+  close();
+  return 0;
+}
@@ -0,0 +1,47 @@
+#ifndef _IS_FileObserver_H_
+#define _IS_FileObserver_H_
+
+#include "IS_Model.h"
+
+/**
+ * Writes the simulation results to 'dir':
+ *   'L.dat', 'T.dat', 'B.dat', 'P.dat' at every call and
+ *   'A_t.csv', 'Mr_t.csv', 'Ma_t.csv', 'F_t.csv' when saveFiles is set,
+ *   every dumpEvery calls, or a single compressed 'S_t.isz' (IS_Compress.h).
+ */
+class IS_FileObserver : public IS_Observer{
+
+  private:
+
+    std::string dir;
+    int saveFiles;
+    int dumpEvery;
+    long int calls;
+    int compress;
+    double absTol[IS_SPECIES];
+    double relTol[IS_SPECIES];
+    FILE* datamatlabA;
+    FILE* datamatlabMr;
+    FILE* datamatlabMa;
+    FILE* datamatlabT;
+    FILE* datamatlabB;
+    FILE* datamatlabP;
+    FILE* datamatlabF;
+    FILE* datamatlabL;
+
+    int checkFile(FILE* theFile);
+    void close();
+
+  public:
+    IS_FileObserver(const std::string& dir, int saveFiles, int dumpEvery = 1);
+    ~IS_FileObserver();
+    void setCompression(int mode, const double absTol[], const double relTol[]);
+    int begin(const IS_Model& model);
+    int observe(const IS_Model& model, long int t);
+    int end(const IS_Model& model, long int t);
+    int write(long int t, const IS_Scalars& s);
+    int writeFields(long int t, const IS_View& u);
+
+};
+
+#endif
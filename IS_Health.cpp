@@ -0,0 +1,140 @@
+#include "IS_Health.h"
+
+/******************************************************************************
+ * 
+ * IS_Health - numerical health monitor of IS_Model.
+ * 
+ * Called by the model every 'healthEvery' time steps, instead of testing
+ * every point as it is computed. The fields are reduced to their sum (NaN
+ * and Inf propagate to it) and minimum, which the compiler vectorizes, or
+ * these values are taken from the integral pass of the model ('fused').
+ * Only when a check fails the fields are scanned to find the point.
+ * 
+ ******************************************************************************/
+
+using namespace std;
+
+static const char* speciesName[IS_SPECIES] = {"A", "MR", "MA", "F"};
+
+IS_Health::IS_Health(int checks, int policy){
+  this->checks    = checks;
+  this->policy    = policy;
+  this->negTol    = 0.0;
+  this->maxChange = 10.0;
+  this->minTotal  = SPACE; //mean value of 1 per point
+  reset();
+}
+
+/**
+ * Setters
+ */
+void IS_Health::setNegativeTolerance(double tol){
+  this->negTol = tol;
+}
+void IS_Health::setMaxChange(double change, double minTotal){
+  this->maxChange = change;
+  this->minTotal  = minTotal;
+}
+
+/**
+ * Forgets the failures of a previous run
+ */
+void IS_Health::reset(){
+  hasTotal = 0;
+  failures = 0;
+  first.t  = last.t = -1;
+}
+
+/**
+ * Bulk check: reduces each field to its sum and minimum
+ */
+int IS_Health::check(const IS_View& u, long int t){
+  double sum[IS_SPECIES], min[IS_SPECIES];
+
+  for(int s = 0; s < IS_SPECIES; s++){
+    double sm = 0.0, mn = u(s,0,0,0);
+    for(int x = 0; x < Xspace; x++) {
+      for(int y = 0; y < Yspace; y++) {
+        for(int z = 0; z < Zspace; z++) {
+          double v = u(s,x,y,z);
+          sm += v;
+          mn = (v < mn) ? v : mn;
+        }
+      }
+    }
+    sum[s] = sm;
+    min[s] = mn;
+  }
+  return check(u, sum, min, t);
+}
+
+/**
+ * Checks the sum and minimum of each species, returns the failed check
+ * (0 if every check passed)
+ */
+int IS_Health::check(const IS_View& u, const double sum[], const double min[], long int t){
+  for(int s = 0; s < IS_SPECIES; s++){
+    if ((checks & IS_CHECK_NAN) && !isfinite(sum[s]))
+      return fail(u, IS_CHECK_NAN, s, t);
+    if ((checks & IS_CHECK_NEGATIVE) && min[s] < -negTol)
+      return fail(u, IS_CHECK_NEGATIVE, s, t);
+    if ((checks & IS_CHECK_MASS) && hasTotal){
+      double ref = fabs(lastTotal[s]) > minTotal ? fabs(lastTotal[s]) : minTotal;
+      if (fabs(sum[s] - lastTotal[s]) > maxChange*ref)
+        return fail(u, IS_CHECK_MASS, s, t);
+    }
+  }
+  for(int s = 0; s < IS_SPECIES; s++) lastTotal[s] = sum[s];
+  hasTotal = 1;
+  return 0;
+}
+
+/**
+ * Finds the first point responsible for the failed check
+ */
+int IS_Health::fail(const IS_View& u, int check, int species, long int t){
+  IS_HealthReport r;
+  r.t = t;
+  r.check = check;
+  r.species = species;
+  r.x = r.y = r.z = -1;
+  r.value = 0.0;
+
+  for(int x = 0; x < Xspace && r.x < 0; x++) {
+    for(int y = 0; y < Yspace && r.x < 0; y++) {
+      for(int z = 0; z < Zspace; z++) {
+        double v = u(species,x,y,z);
+        if (((check == IS_CHECK_NAN) && !isfinite(v))
+            || ((check == IS_CHECK_NEGATIVE) && v < -negTol)){
+          r.x = x; r.y = y; r.z = z;
+          r.value = v;
+          break;
+        }
+      }
+    }
+  }
+  if (check == IS_CHECK_MASS){
+    double sum = 0.0;
+    for(int x = 0; x < Xspace; x++)
+      for(int y = 0; y < Yspace; y++)
+        for(int z = 0; z < Zspace; z++) sum += u(species,x,y,z);
+    r.value = sum;
+  }
+
+  if (failures == 0) first = r;
+  last = r;
+  failures++;
+  return check;
+}
+
+std::string IS_Health::describe(const IS_HealthReport& r) const{
+  std::ostringstream sstream;
+  sstream << speciesName[r.species];
+  if (r.check == IS_CHECK_NAN) sstream << "\t(NaN)";
+  else if (r.check == IS_CHECK_NEGATIVE) sstream << "\t(negative)";
+  else sstream << "\t(mass balance)";
+  sstream << "-> t: " << r.t;
+  if (r.x >= 0) sstream << " -> (" << r.x << " " << r.y << " " << r.z << ")";
+  sstream << " -> " << r.value << "\n";
+  return sstream.str();
+}
@@ -0,0 +1,71 @@
+#ifndef _IS_Health_H_
+#define _IS_Health_H_
+
+#include "IS_Model.h"
+
+/**
+ * Checks done by IS_Health (IS_Config::healthChecks)
+ */
+const int IS_CHECK_NAN      = 1; //NaN or Inf values
+const int IS_CHECK_NEGATIVE = 2; //values below -negTol
+const int IS_CHECK_MASS     = 4; //species total changing more than maxChange times
+                                 //max(previous total, minTotal) between checks
+
+/**
+ * What the model does when a check fails (IS_Config::healthPolicy)
+ */
+const int IS_WARN     = 0; //prints the first failure and goes on
+const int IS_ABORT    = 1; //stops the simulation
+const int IS_ROLLBACK = 2; //goes back to the last healthy check with half the deltaT
+
+const int IS_MAX_ROLLBACKS = 10; //rollbacks of a run before IS_ROLLBACK aborts
+
+/**
+ * Where and when a check failed
+ */
+struct IS_HealthReport{
+  long int t;      //time step
+  int check;       //IS_CHECK_*
+  int species;     //0 A, 1 MR, 2 MA, 3 F
+  int x, y, z;     //first offending point
+  double value;
+};
+
+/**
+ * Numerical health monitor: checks the whole fields at once (sum and
+ * minimum of each species) and only looks for the offending point when
+ * something is wrong.
+ */
+class IS_Health{
+
+  private:
+
+    int checks;
+    int policy;
+    double negTol;
+    double maxChange;
+    double minTotal;
+    double lastTotal[IS_SPECIES];
+    int hasTotal;
+    long int failures;
+    IS_HealthReport first;
+    IS_HealthReport last;
+
+    int fail(const IS_View& u, int check, int species, long int t);
+
+  public:
+    IS_Health(int checks = IS_CHECK_NAN, int policy = IS_WARN);
+    void setNegativeTolerance(double tol);
+    void setMaxChange(double change, double minTotal = SPACE);
+    void reset();
+    int check(const IS_View& u, long int t);
+    int check(const IS_View& u, const double sum[], const double min[], long int t);
+    int getPolicy() const { return policy; }
+    long int getFailures() const { return failures; }
+    const IS_HealthReport& getFirst() const { return first; }
+    const IS_HealthReport& getLast() const { return last; }
+    std::string describe(const IS_HealthReport& r) const;
+
+};
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef _IS_Layout_H_
+#define _IS_Layout_H_
+
+/******************************************************************************
+ *
+ * IS_Layout - storage layouts of the fields A, MR, MA and F.
+ *
+ * The solver loops of IS_Model are templates on the accessor, u(s,b,x,y,z)
+ * being species s (0 A, 1 MR, 2 MA, 3 F) at time level b of point x,y,z.
+ * Everything else (output, analytics, health checks, checkpoints) reads
+ * the current time level through IS_View, in either layout.
+ * Included by IS_Model.h.
+ *
+ ******************************************************************************/
+
+/**
+ * Layouts (IS_Config::layout)
+ */
+const int IS_SOA   = 0; //one [buffer][Xspace][Yspace][Zspace] array per species
+const int IS_AOSOA = 1; //the four species interleaved in chunks of IS_CHUNK z values
+
+const int IS_CHUNK   = 4; //z values per chunk (a power of two), one AVX register of doubles
+const int IS_ZCHUNKS = (Zspace + IS_CHUNK - 1)/IS_CHUNK;
+const int IS_AOSOA_PLANE = Yspace*IS_ZCHUNKS*IS_SPECIES*IS_CHUNK; //values per x plane
+const int IS_AOSOA_LEVEL = Xspace*IS_AOSOA_PLANE;                //values per time level
+
+/**
+ * Separate arrays, as allocated by IS_AllocField
+ */
+struct IS_SoA{
+  double (*f[IS_SPECIES])[Xspace][Yspace][Zspace];
+
+  inline double& operator()(int s, int b, int x, int y, int z) const {
+    return f[s][b][x][y][z];
+  }
+};
+
+/**
+ * [buffer][Xspace][Yspace][IS_ZCHUNKS][IS_SPECIES][IS_CHUNK]: a voxel and
+ * its z neighbours share the cache lines of all species (the z values of
+ * the last chunk past Zspace are padding)
+ */
+struct IS_AoSoA{
+  double* data;
+
+  inline double& operator()(int s, int b, int x, int y, int z) const {
+    return data[(size_t)b*IS_AOSOA_LEVEL + x*IS_AOSOA_PLANE + y*IS_ZCHUNKS*IS_SPECIES*IS_CHUNK
+                + (z & ~(IS_CHUNK-1))*IS_SPECIES + s*IS_CHUNK + (z & (IS_CHUNK-1))];
+  }
+};
+
+/**
+ * Current time level (level 0) of the fields in the layout of the run, as
+ * read by the observers and the health checks: u(s,x,y,z)
+ */
+struct IS_View{
+  int layout;
+  IS_SoA soa;
+  IS_AoSoA aosoa;
+
+  inline double operator()(int s, int x, int y, int z) const {
+    return (layout == IS_AOSOA) ? aosoa(s,0,x,y,z) : soa(s,0,x,y,z);
+  }
+};
+
+/**
+ * Species s at time level b of any layout, as a function of x, y, z
+ */
+template<class L>
+struct IS_Level{
+  const L& u;
+  int s, b;
+
+  IS_Level(const L& u, int s, int b) : u(u), s(s), b(b){}
+  inline double operator()(int x, int y, int z) const { return u(s, b, x, y, z); }
+};
+
+#endif
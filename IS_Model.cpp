@@ -1,4 +1,12 @@
 #include "IS_Model.h"
+#include "IS_FileObserver.h"
+#include "IS_Analytics.h"
+#include "IS_Health.h"
+#include "IS_Numa.h"
+#include "IS_Telemetry.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 /******************************************************************************
  * 
@@ -31,6 +39,15 @@
  *  
  *             model->solve();
  * 
+ *          Or drive the simulation step by step (no files written unless
+ *          an IS_FileObserver is registered):
+ * 
+ *             model->addObserver(&observer, model->getSnapshotInterval());
+ *             model->reset();
+ *             model->advance_to(10.0); // or model->step(n)
+ *             model->getFields(); model->getScalars();
+ *             model->finish();
+ * 
  * 
  * Obs: Considers logistic growth of bacteria.
  * 
@@ -86,15 +103,74 @@ std::string IS_Model::Footer(long int t){
  */
 void IS_Model::setSaveFiles(int sf){
     this->saveFiles = sf;
+    this->config.saveFiles = sf;
 }
 void IS_Model::setSimulationCase(int sc){
     this->simCase = sc;
+    this->config.simCase = sc;
+    this->initialized = 0;
 }
 
 /**
-* Constructor set parameters
+* Default simulation definitions
+*/
+IS_Config::IS_Config(){
+  simCase    = 0;
+  saveFiles  = 1;
+  days       = 30;
+  points     = 720;
+  lnv        = 2;
+  bv         = 2;
+  /**
+   * each (5/(pow(10,6)) = 0.0000002 days or 0,01728 secs
+   */
+  deltaT     = 0.001;
+  /**
+   * each 1000000 iterations represents 1 day
+   */
+  iterPerDay = 10000;
+  dir        = "output/";
+  /**
+   * fields saved at every point, no in-situ reductions
+   */
+  dumpEvery  = 1;
+  analytics  = 0;
+  /**
+   * fields saved as csv, lossy compression keeps 6 significant digits
+   */
+  compress   = 0;
+  for(int s = 0; s < IS_SPECIES; s++){
+    absTol[s] = 0.0;
+    relTol[s] = pow(10,-6);
+  }
+  /**
+   * warns about NaN values at every point
+   */
+  healthChecks = IS_CHECK_NAN;
+  healthPolicy = IS_WARN;
+  healthEvery  = 0;
+  healthFused  = 0;
+  /**
+   * fields first touched by the threads that compute them,
+   * no huge pages or pinning
+   */
+  hugePages    = 0;
+  pinThreads   = 0;
+  numaReport   = 0;
+  /**
+   * no live telemetry
+   */
+  telemetry    = "";
+  /**
+   * one array per species
+   */
+  layout       = IS_SOA;
+}
+
+/**
+* Simulation definitions from the simdefs[] array
 */
-IS_Model::IS_Model(double simdefs[]){
+IS_Config::IS_Config(double simdefs[]) : IS_Config(){
 
   /** 
    * 0 - simulates coupled model, 
@@ -102,42 +178,176 @@ IS_Model::IS_Model(double simdefs[]){
    * 2 - simulates only innate response,
    * 3 - complete model without diffusion.
    */  
-  //simCase   = 0;  
-   this->simCase   = simdefs[0];
+  this->simCase   = simdefs[0];
   /** 
    * 0 - saves only edos files, 
    * 1 - saves all files.
    */
-  //saveFiles = 1;
   this->saveFiles = simdefs[1];
   /**
    * number of days simulated
    */
-  //days      = 30;
   this->days      = simdefs[2];
   /**
    * number of files saved
    */
-  //points    = 720;
   this->points    = simdefs[3];
   /**
    * 0 - contact with lymph vessels only on one border, 
    * 1 - homogeneous contact with lymph vessels.
    * 2 - contact with lymph vessels given by function.
    */
-  //lnv       = 2;
   this->lnv       = simdefs[4];
   /**
    * 0 - contact with blood vessels only on one border,
    * 1 - homogeneous contact with blood vessels,  
    * 2 - contact with blood vessels given by function.
    */
-  //bv        = 2;
   this->bv        = simdefs[5];
-  /**
-   * output directory
-   */
-  this->dir       = (char *) "output/";
+}
+
+/**
+* Constructor set parameters
+*/
+IS_Model::IS_Model(double simdefs[]) : IS_Model(IS_Config(simdefs)){
+}
+
+IS_Model::IS_Model(const IS_Config& cfg){
+  this->config      = cfg;
+  this->simCase     = cfg.simCase;
+  this->saveFiles   = cfg.saveFiles;
+  this->days        = cfg.days;
+  this->points      = cfg.points;
+  this->lnv         = cfg.lnv;
+  this->bv          = cfg.bv;
+  this->deltaT      = cfg.deltaT;
+  this->iterPerDay  = cfg.iterPerDay;
+  this->t           = 0;
+  this->initialized = 0;
+  this->stepScale   = 1;
+  this->health      = NULL;
+  this->healthEvery = 1;
+  this->healthFused = 0;
+  this->ckpt.t      = 0;
+  this->rollbacks   = 0;
+  this->observed    = -1;
+  this->allocFailed = 0;
+  this->layout      = (cfg.layout == IS_AOSOA) ? IS_AOSOA : IS_SOA;
+
+  //threads are pinned before the first touch of the fields
+  if (cfg.pinThreads) IS_PinThreads();
+  this->A = this->MR = this->MA = this->F = NULL;
+  this->U  = NULL;
+  if (layout == IS_AOSOA){
+    this->U = (double*)IS_AllocPlanes(sizeof(double)*IS_AOSOA_PLANE, buffer, cfg.hugePages);
+    if (!U) this->allocFailed = 1;
+  } else {
+    this->A  = IS_AllocField(cfg.hugePages);
+    this->MR = IS_AllocField(cfg.hugePages);
+    this->MA = IS_AllocField(cfg.hugePages);
+    this->F  = IS_AllocField(cfg.hugePages);
+    if (!A || !MR || !MA || !F) this->allocFailed = 1;
+  }
+  soa.f[0] = A;
+  soa.f[1] = MR;
+  soa.f[2] = MA;
+  soa.f[3] = F;
+  aosoa.data = U;
+}
+
+IS_Model::~IS_Model(){
+  IS_FreeField(A);
+  IS_FreeField(MR);
+  IS_FreeField(MA);
+  IS_FreeField(F);
+  IS_FreePlanes(U, sizeof(double)*IS_AOSOA_PLANE, buffer);
+}
+
+/**
+ * NUMA nodes of the pages of each field
+ */
+std::string IS_Model::Placement() const{
+  std::string returnstring;
+  int threads = 1;
+#ifdef _OPENMP
+  threads = omp_get_max_threads();
+#endif
+  std::ostringstream sstream;
+  sstream << threads;
+  returnstring += "Threads : "+sstream.str()+"\n";
+  if (layout == IS_AOSOA){
+    returnstring += "Interleaved pages -> "+IS_Placement(U, sizeof(double)*buffer*IS_AOSOA_LEVEL)+"\n";
+  } else {
+    returnstring += "A  pages -> "+IS_Placement(A)+"\n";
+    returnstring += "MR pages -> "+IS_Placement(MR)+"\n";
+    returnstring += "MA pages -> "+IS_Placement(MA)+"\n";
+    returnstring += "F  pages -> "+IS_Placement(F)+"\n";
+  }
+  return returnstring;
+}
+
+/**
+ * Parameter values of a run with the given configuration: the values of
+ * the tables below, replaced by the ones in cfg.params. Available without
+ * allocating a model.
+ */
+IS_Params<double> IS_Model::getParams(const IS_Config& cfg){
+  IS_Params<double> p;
+
+  //Table 1: Initial values of the coupled model.
+  p.a0       = 2.0;//1.7*pow(10,2);
+  p.m0       = 0.0; //MA0
+  p.f0       = 0.;//1.0*pow(10,1);//*MOL;
+  p.th0      = 0.0;
+  p.b0       = 0.0;
+  p.p0       = 0.0;
+  p.t_estrela  = 8.4*pow(10,-3);//*MOL;
+  p.b_estrela  = 8.4*pow(10,-4);//*MOL;
+  p.p_estrela  = 8.4*pow(10,-6);//*MOL;
+  p.f_estrela  = 0.;//9.5*pow(10,-6);//*MOL;
+  p.m_estrela  = 4.0;//2.3*pow(10,2);//*MOL //MR0
+
+  //Table 2:diffusion coefficients
+  p.d_a      = 0.00037;       //antigen diffusion (Haessler)
+  p.d_mr     = 0.0432;        //resting macrophage diffusion (estimated)
+  p.d_ma     = 0.3;           //active macrophage diffusion (estimated)
+  p.d_f      = 0.016;         //antibody diffusion (estimated)
+
+  //Table 3: Replication, decay, activation, and phagocytosis rates.
+  p.beta_A   = 2.0;            //bacteria replication
+  p.k_A      = 50.0;           //bacteria maximum capacity
+  p.m_A      = 0.1;            //bacteria natural decay
+  p.m_Mr     = 0.033;          //resting macrophage natural decay
+  p.m_Ma     = 0.07;           //activated macrophage natural decay
+  p.gamma_ma = 8.30*pow(10,-2); //macrophage activation
+  p.lambda_mr  = 5.98*pow(10,-3); //resting macrophage fagocitosis rate
+  p.lambda_ma  = 5.98*pow(10,-2); //activated macrophage fagocitosis rate
+  p.lambda_afmr= 1.66*pow(10,-3); //resting macrophage fagocitosis rate for opsonized antigen
+  p.lambda_afma= 7.14*pow(10,-2); //activated macrophage fagocitosis rate for opsonized antigen
+  
+  //Table 4: Other coefficients used in the coupled model.
+  p.alpha_Ma = 0.001;//*pow(10,1);  //migration (estimated)
+  p.alpha_t  = 0.01;           //th2 natural decay
+  p.alpha_b  = 1.0;            //b natural decay
+  p.alpha_p  = 5.0;            //plasma decay
+  p.alpha_f  = 0.43;           //antibody migration
+  p.alpha_mr = 4.0;            //resting macrophage source coefficient
+  p.b_th     = 1.7*pow(10,-2); //th2 stimuli
+  p.b_p      = 1.*pow(10,5);   //th2 expenditure to stimulate b
+  p.b_pb     = 6.02*pow(10,3); //b stimuli
+  p.b_pp     = 2.3*pow(10,6);  //b stimuli while describes plasma cell
+  p.ro_t     = 2.0;            //th2 descendents
+  p.ro_b     = 16.0;           //b descendents
+  p.ro_p     = 3.0;            //p descendents
+  p.ro_f     = 5.1*pow(10,4);  //antibody release
+  //VLN simplificado
+
+  for(map<string, double>::const_iterator it = cfg.params.begin(); it != cfg.params.end(); ++it){
+    double* value = IS_ParamByName(p, it->first);
+    if (value) *value = it->second;
+    else cout << "Unknown parameter : " << it->first << "\n";
+  }
+  return p;
 }
 
 /**
@@ -145,14 +355,6 @@ IS_Model::IS_Model(double simdefs[]){
 */
 void IS_Model::initialize(){
 
-  /**
-   * each (5/(pow(10,6)) = 0.0000002 days or 0,01728 secs
-   */
-  deltaT     = 0.001;
-  /**
-   * each 1000000 iterations represents 1 day
-   */
-  iterPerDay = 10000;
   /**
    * each deltaX represents 100 micrometers ((1 × 10^-6 m)), a cell
    * has 1000 cubic micrometers, each discretized space has 1.000.000 cubic micrometers,
@@ -164,19 +366,10 @@ void IS_Model::initialize(){
   
   tol        = pow(10,-6); //tolerância para quantidade de bacterias (prox 0)
 
-  //Table 1: Initial values of the coupled model.
-  a0         = 2.0;//1.7*pow(10,2);
-  m0         = 0.0; //MA0
-  f0         = 0.;//1.0*pow(10,1);//*MOL;
-  th0        = 0.0;
-  b0         = 0.0;
-  p0         = 0.0;
-  t_estrela  = 8.4*pow(10,-3);//*MOL;
-  b_estrela  = 8.4*pow(10,-4);//*MOL;
-  p_estrela  = 8.4*pow(10,-6);//*MOL;
-  f_estrela  = 0.;//9.5*pow(10,-6);//*MOL;
-  m_estrela  = 4.0;//2.3*pow(10,2);//*MOL //MR0
-
+  par = getParams(config);
+#define IS_PARAM_SET(n) n = par.n;
+  IS_PARAM_LIST(IS_PARAM_SET)
+#undef IS_PARAM_SET
   
   MA_T    = 0.0; //concentration of active macrophages in the tissue
   MA_L    = 0.0; //active macrophages in the lympho node
@@ -188,81 +381,50 @@ void IS_Model::initialize(){
   F_L     = f0;  //f_estrela; Antigens in the lympho node
   A_T     = a0;  //bacteria S. aureus in the tissue
 
-  //Table 2:diffusion coefficients
-  d_a        = 0.00037;       //antigen diffusion (Haessler)
-  d_mr       = 0.0432;        //resting macrophage diffusion (estimated)
-  d_ma       = 0.3;           //active macrophage diffusion (estimated)
-  d_f        = 0.016;         //antibody diffusion (estimated)
-
-  //Table 3: Replication, decay, activation, and phagocytosis rates.
-  beta_A     = 2.0;            //bacteria replication
-  k_A        = 50.0;           //bacteria maximum capacity
-  m_A        = 0.1;            //bacteria natural decay
-  m_Mr       = 0.033;          //resting macrophage natural decay
-  m_Ma       = 0.07;           //activated macrophage natural decay
-  gamma_ma   = 8.30*pow(10,-2); //macrophage activation
-  lambda_mr  = 5.98*pow(10,-3); //resting macrophage fagocitosis rate
-  lambda_ma  = 5.98*pow(10,-2); //activated macrophage fagocitosis rate
-  lambda_afmr= 1.66*pow(10,-3); //resting macrophage fagocitosis rate for opsonized antigen
-  lambda_afma= 7.14*pow(10,-2); //activated macrophage fagocitosis rate for opsonized antigen
-  
-  //Table 4: Other coefficients used in the coupled model.
-  alpha_Ma   = 0.001;//*pow(10,1);  //migration (estimated)
-  alpha_t    = 0.01;           //th2 natural decay
-  alpha_b    = 1.0;            //b natural decay
-  alpha_p    = 5.0;            //plasma decay
-  alpha_f    = 0.43;           //antibody migration
-  alpha_mr   = 4.0;            //resting macrophage source coefficient
-  b_th       = 1.7*pow(10,-2); //th2 stimuli
-  b_p        = 1.*pow(10,5);   //th2 expenditure to stimulate b
-  b_pb       = 6.02*pow(10,3); //b stimuli
-  b_pp       = 2.3*pow(10,6);  //b stimuli while describes plasma cell
-  ro_t       = 2.0;            //th2 descendents
-  ro_b       = 16.0;           //b descendents
-  ro_p       = 3.0;            //p descendents
-  ro_f       = 5.1*pow(10,4);  //antibody release
-  //VLN simplificado
-
   /**
    * Initial Conditions
    */
   for(int x = 0; x < Xspace; x++) {
     for(int y = 0; y < Yspace; y++) {
       for(int z = 0; z < Zspace; z++) {
-        if (simCase == 3){ //no diffusion
-          A[0][x][y][z] = a0;
-	      }else{
-          //bacteria only in the center of the cubic domain
-          if ((x > (0.2*Xspace)&&( x < (0.7*Xspace)))
-            && (y > (0.2*Yspace)&&( y < (0.7*Yspace)))
-            && (z > (0.2*Zspace)&&( z < (0.7*Zspace)))) {
-		          A[0][x][y][z] = a0;///IC_SPACE;
-		      } else {
-		           A[0][x][y][z] = 0.0;
-          }	  
-	      }
-	      MR[0][x][y][z]  = m_estrela;
-        MA[0][x][y][z]  = 0.0;
-        F[0][x][y][z]   = f0;//SPACE;
+        IS_InitialPoint(par, simCase, x, y, z, at(0,x,y,z), at(1,x,y,z), at(2,x,y,z), at(3,x,y,z));
       }
     }
   }
 }
 
 /**
- * Updates the current results to position 1
- * and sets the previous results to zero
+ * Species s of point x,y,z at the current time level, in the layout of the run
+ */
+double& IS_Model::at(int s, int x, int y, int z){
+  return (layout == IS_AOSOA) ? aosoa(s,0,x,y,z) : soa(s,0,x,y,z);
+}
+
+IS_View IS_Model::getFields() const{
+  IS_View u;
+  u.layout = layout;
+  u.soa    = soa;
+  u.aosoa  = aosoa;
+  return u;
+}
+
+/**
+ * Updates the current results of the first 'species' species to position 1
+ * and sets the previous results to zero (one pass, so the interleaved
+ * layout is read in order)
  */
-void IS_Model::update(double vec[][Xspace][Yspace][Zspace]){
+template<class L>
+void IS_Model::update(const L& u, int species){
+  #pragma omp parallel for schedule(static)
   for(int x = 0; x < Xspace; x++) {
     for(int y = 0; y < Yspace; y++) {
       for(int z = 0; z < Zspace; z++) {
-        vec[0][x][y][z] = vec[1][x][y][z];
+        for(int s = 0; s < species; s++) u(s,0,x,y,z) = u(s,1,x,y,z);
         /**
          * In case it is necessary to keep the previous
 	       * just comment the line below
 	       */
-	      //vec[1][x][y][z] = 0.;
+	      //for(int s = 0; s < species; s++) u(s,1,x,y,z) = 0.;
       }
     }
   }
@@ -271,59 +433,37 @@ void IS_Model::update(double vec[][Xspace][Yspace][Zspace]){
 /**
  * Calculates the laplacian for given value and position
  */
-double IS_Model::laplacian(double vec[][Xspace][Yspace][Zspace], int x, int y, int z){
-	double resX = 0, resY = 0, resZ = 0;
-	// same boundary condition to every equation
-	if(x == 0) {
-		resX = (vec[0][x+1][y][z] - vec[0][x][y][z])/(deltaX*deltaX);
-	} else if(x == Xspace-1 ) {
-		resX = (vec[0][x-1][y][z] - vec[0][x][y][z])/(deltaX*deltaX);
-	} else {//dentro do dominio mas fora da extremidade
-		resX = (vec[0][x+1][y][z] -2 * vec[0][x][y][z] + vec[0][x-1][y][z])/(deltaX*deltaX);
-	}
-	if(y == 0) {
-		resY = (vec[0][x][y+1][z] - vec[0][x][y][z])/(deltaY*deltaY);
-	} else if( y == Yspace-1) {
-		resY = (vec[0][x][y-1][z] - vec[0][x][y][z])/(deltaY*deltaY);
-	} else {
-		resY = (vec[0][x][y+1][z] -2 * vec[0][x][y][z] + vec[0][x][y-1][z])/(deltaY*deltaY);
-	}
-	if(z == 0) {
-		resZ = (vec[0][x][y][z+1] - vec[0][x][y][z])/(deltaZ*deltaZ);
-	} else if( z == Zspace-1) {
-		resZ = (vec[0][x][y][z-1] - vec[0][x][y][z])/(deltaZ*deltaZ);
-	} else {
-		resZ = (vec[0][x][y][z+1] -2 * vec[0][x][y][z] + vec[0][x][y][z-1])/(deltaZ*deltaZ);
-	}
-	return resX+resY+resZ;
-}
-
-/**
- * Tests if the file could be created and exits the simulation if
- * there was an error
- */
-int IS_Model::checkFile(FILE* theFile){
-  if (theFile==NULL){
-    cout << "Error opening file!!!\n Make sure the path is correct! \n";
-    return 1;
-  }
-  return 0;
+template<class L>
+double IS_Model::laplacian(const L& u, int s, int x, int y, int z){
+  return IS_LaplacianAt<double>(IS_Level<L>(u, s, 0), x, y, z, deltaX, deltaY, deltaZ);
 }
 
 /**
  * Calculates integrals of cells in the tissue and return the value as
- * a pointer 
+ * a pointer. The sum and minimum of the whole field go to stats (used
+ * by the health monitor).
  */
-int IS_Model::calcIntegral(double vec[][Xspace][Yspace][Zspace], double *V){
+template<class L>
+int IS_Model::calcIntegral(const L& u, int s, double *V, double *stats){
+
+  double sum = 0.0, min = u(s,0,0,0,0), integral = *V;
+
+  #pragma omp parallel for schedule(static) reduction(+:integral,sum) reduction(min:min)
 
   for(int x = 0; x < Xspace; x++) {
 	for(int y = 0; y < Yspace; y++) {
 	  for(int z = 0; z < Zspace; z++) {
-	    if (vec[0][x][y][z]>0.0) *V += vec[0][x][y][z];
+	    if (u(s,0,x,y,z)>0.0) integral += u(s,0,x,y,z);
+	    if (stats){ //health check step only
+	      sum += u(s,0,x,y,z);
+	      min = (u(s,0,x,y,z) < min) ? u(s,0,x,y,z) : min;
+	    }
 	  }
 	}
   }
+  *V = integral;
   if (*V > 0.0) *V = (*V/(SPACE)); else *V = 0.0;
+  if (stats){ stats[0] = sum; stats[1] = min; }
   return 0;
 }
 
@@ -331,43 +471,70 @@ int IS_Model::calcIntegral(double vec[][Xspace][Yspace][Zspace], double *V){
  * For activated macrophages the integral is calculated considering only 
  * the cells in contact with lymph vessels
  */
-int IS_Model::calcIntegral_lv(double vec[][Xspace][Yspace][Zspace], double *V){
+template<class L>
+int IS_Model::calcIntegral_lv(const L& u, int s, double *V, double *stats){
+
+  double sum = 0.0, min = u(s,0,0,0,0), integral = *V;
+
+  #pragma omp parallel for schedule(static) reduction(+:integral,sum) reduction(min:min)
 
   for(int x = 0; x < Xspace; x++) {
     for(int y = 0; y < Yspace; y++) {
       for(int z = 0; z < Zspace; z++) {
-	      if (((lnv==0)&&(x==0))||(lnv==1)||((lnv==2)&&(is_lnvase(x,y,z)))){
-	        if (vec[0][x][y][z]>0.0) *V += vec[0][x][y][z];
+	      if (lymphContact(x,y,z)){
+	        if (u(s,0,x,y,z)>0.0) integral += u(s,0,x,y,z);
+	      }
+	      if (stats){
+	        sum += u(s,0,x,y,z);
+	        min = (u(s,0,x,y,z) < min) ? u(s,0,x,y,z) : min;
 	      }
       }
     }
   }
+  *V = integral;
   if (*V > 0.0) *V = (*V/(SPACE)); else *V = 0.0;
+  if (stats){ stats[0] = sum; stats[1] = min; }
     return 0;
 }
 
 /**
  * for antibodies consider only cells in contact with blood vessels
  */
-int IS_Model::calcIntegral_bv(double vec[][Xspace][Yspace][Zspace], double *V){
+template<class L>
+int IS_Model::calcIntegral_bv(const L& u, int s, double *V, double *stats){
+
+  double sum = 0.0, min = u(s,0,0,0,0), integral = *V;
+
+  #pragma omp parallel for schedule(static) reduction(+:integral,sum) reduction(min:min)
 
   for(int x = 0; x < Xspace; x++) {
     for(int y = 0; y < Yspace; y++) {
       for(int z = 0; z < Zspace; z++) {
-	      if (((bv==0)&&(x==0))||(bv==1)||((bv==2)&&(is_bvase(x,y,z)))){
-	       if (vec[0][x][y][z]>0.0) *V += vec[0][x][y][z];
+	      if (bloodContact(x,y,z)){
+	       if (u(s,0,x,y,z)>0.0) integral += u(s,0,x,y,z);
       	}
+	      if (stats){
+	        sum += u(s,0,x,y,z);
+	        min = (u(s,0,x,y,z) < min) ? u(s,0,x,y,z) : min;
+	      }
       }
     }
   }
+  *V = integral;
   if (*V > 0.0) *V = (*V/(SPACE)); else *V = 0.0;
+  if (stats){ stats[0] = sum; stats[1] = min; }
     return 0;
 }
 
 /**
  * returns 1 if the point is a blood vase and 0 if it is not
+ *
+ * The vases are placed on a 10 point grid (1 mm), scaled to Xspace and
+ * Zspace when IS_GRID is not 10.
  */
 int IS_Model::is_bvase(int x, int y, int z){
+  x = (10*x)/Xspace;
+  z = (10*z)/Zspace;
   //if(((x >= 0)&&(x <= 1))||((x>=4)&&(x<=5))||((x>=8)&&(x<=9)))
   //  if(((z >= 0)&&(z <= 1))||((z>=4)&&(z<=5))||((z>=8)&&(z<=9)))
  if(((x >= 0)&&(x <= 1))||((x>=8)&&(x<=9)))
@@ -378,9 +545,12 @@ int IS_Model::is_bvase(int x, int y, int z){
 }
 
 /**
- * returns 1 if the point is a lymph vase and 0 if it is not
+ * returns 1 if the point is a lymph vase and 0 if it is not (positions
+ * scaled as in is_bvase())
  */
 int IS_Model::is_lnvase(int x, int y, int z){
+  x = (10*x)/Xspace;
+  z = (10*z)/Zspace;
   if(((x >= 2)&&(x <= 3))||((x>=6)&&(x<=7)))
     if(((z >= 0)&&(z <= 1))||((z>=4)&&(z<=5)))
       return 1;
@@ -388,215 +558,450 @@ int IS_Model::is_lnvase(int x, int y, int z){
   return 0;     
 }
 
+/**
+ * returns 1 if the point is in contact with blood vessels
+ * 
+ * Assuming: contact with blood vessels only on one border bv = 0
+ *           homogeneous contact with blood vessels bv = 1   
+ *           contact with blood vessels given by function bv = 2
+ */
+int IS_Model::bloodContact(int x, int y, int z) const{
+  return bloodContact(bv, x, y, z);
+}
+int IS_Model::bloodContact(int bv, int x, int y, int z){
+  return ((bv==0)&&(x==0))||(bv==1)||((bv==2)&&(is_bvase(x,y,z)));
+}
+
+/**
+ * returns 1 if the point is in contact with lymph vessels
+ * 
+ * Assuming: contact with lymph vessels only on one border lnv = 0
+ *           homogeneous contact with lymph vessels lnv = 1   
+ *           contact with lymph vessels given by function lnv = 2
+ */
+int IS_Model::lymphContact(int x, int y, int z) const{
+  return lymphContact(lnv, x, y, z);
+}
+int IS_Model::lymphContact(int lnv, int x, int y, int z){
+  return ((lnv==0)&&(x==0))||(lnv==1)||((lnv==2)&&(is_lnvase(x,y,z)));
+}
+
+
+/******************************************************************************
+* Stepping API
+*******************************************************************************/
+
+/**
+ * Sets the initial conditions and starts a new run
+ */
+int IS_Model::reset(){
+  if (allocFailed){
+    if (allocFailed++ == 1) cout << "Error allocating the fields!!!\n";
+    return 1;
+  }
+  initialize();
+  t = 0;
+  initialized = 1;
+  //undo the rollbacks of a previous run
+  deltaT     = config.deltaT;
+  stepScale  = 1;
+  rollbacks  = 0;
+  observed   = -1;
+  if (health){
+    health->reset();
+    if (health->getPolicy() == IS_ROLLBACK) getCheckpoint(ckpt);
+  }
+  for(size_t o = 0; o < observers.size(); o++){
+    if (observers[o]->begin(*this)) return 1;
+  }
+  return 0;
+}
+
+/**
+ * Closes the run for every observer
+ */
+int IS_Model::finish(){
+  int status = 0;
+  for(size_t o = 0; o < observers.size(); o++){
+    if (observers[o]->end(*this, t)) status = 1;
+  }
+  return status;
+}
+
+/**
+ * returns 1 when the simulated days are over or the bacteria is gone
+ */
+int IS_Model::finished() const{
+  return !((t < (iterPerDay*days)) && (A_T > tol));
+}
+
+/**
+ * Registers an observer called every 'interval' time steps
+ */
+void IS_Model::addObserver(IS_Observer* obs, long int interval){
+  if (interval < 1) interval = 1;
+  observers.push_back(obs);
+  intervals.push_back(interval);
+}
+
+void IS_Model::removeObserver(IS_Observer* obs){
+  for(size_t o = 0; o < observers.size(); o++){
+    if (observers[o] == obs){
+      observers.erase(observers.begin()+o);
+      intervals.erase(intervals.begin()+o);
+      return;
+    }
+  }
+}
+
+/**
+ * Checks the fields every 'every' time steps, 'fused' takes the sums
+ * computed with the tissue integrals instead of a separate pass.
+ * A run already started rolls back at most to the current state.
+ */
+void IS_Model::setHealthMonitor(IS_Health* monitor, long int every, int fused){
+  this->health      = monitor;
+  this->healthEvery = (every < 1) ? 1 : every;
+  this->healthFused = fused;
+  if (health && initialized && health->getPolicy() == IS_ROLLBACK) getCheckpoint(ckpt);
+}
+
+/**
+ * Number of time steps between saved points
+ */
+long int IS_Model::getSnapshotInterval() const{
+  return ((int)iterPerDay*days)/points;
+}
+
+IS_Scalars IS_Model::getScalars() const{
+  IS_Scalars s;
+  s.A_T  = A_T;
+  s.MA_T = MA_T;
+  s.MR_T = MR_T;
+  s.F_T  = F_T;
+  s.MA_L = MA_L;
+  s.Th   = Th;
+  s.B    = B;
+  s.P    = P;
+  s.F_L  = F_L;
+  return s;
+}
+
+/**
+ * Copies the current state
+ */
+void IS_Model::getCheckpoint(IS_Checkpoint& c) const{
+  IS_View u = getFields();
+  c.fields.resize(IS_SPECIES*SPACE);
+  for(int s = 0; s < IS_SPECIES; s++){
+    double* v = &c.fields[s*SPACE];
+    for(int x = 0; x < Xspace; x++)
+      for(int y = 0; y < Yspace; y++)
+        for(int z = 0; z < Zspace; z++) *v++ = u(s,x,y,z);
+  }
+  c.scalars = getScalars();
+  c.t = t;
+}
+
+/**
+ * Continues the run from the given state (the initial conditions are set
+ * first if the run was not started)
+ */
+int IS_Model::setCheckpoint(const IS_Checkpoint& c){
+  if (c.fields.size() != (size_t)IS_SPECIES*SPACE) return 1;
+  if (!initialized && reset()) return 1;
+  for(int s = 0; s < IS_SPECIES; s++){
+    const double* v = &c.fields[s*SPACE];
+    for(int x = 0; x < Xspace; x++)
+      for(int y = 0; y < Yspace; y++)
+        for(int z = 0; z < Zspace; z++) at(s,x,y,z) = *v++;
+  }
+  A_T  = c.scalars.A_T;
+  MA_T = c.scalars.MA_T;
+  MR_T = c.scalars.MR_T;
+  F_T  = c.scalars.F_T;
+  MA_L = c.scalars.MA_L;
+  Th   = c.scalars.Th;
+  B    = c.scalars.B;
+  P    = c.scalars.P;
+  F_L  = c.scalars.F_L;
+  t    = c.t;
+  observed = -1;
+  return 0;
+}
+
+/**
+ * Parameter values of the current run (set by initialize)
+ */
+IS_Params<double> IS_Model::getParams() const{
+  IS_Params<double> p;
+#define IS_PARAM_COPY(n) p.n = n;
+  IS_PARAM_LIST(IS_PARAM_COPY)
+#undef IS_PARAM_COPY
+  return p;
+}
+
+/**
+ * Calls the observers due at time step t, once (the state a rollback goes
+ * back to was already given to them)
+ */
+int IS_Model::notify(long int t){
+  if (t == observed) return 0;
+  observed = t;
+  for(size_t o = 0; o < observers.size(); o++){
+    if (t%intervals[o] == 0){
+      if (observers[o]->observe(*this, t)) return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Advances at most n time steps, stops earlier if the simulation is over
+ */
+int IS_Model::step(long int n){
+  if (!initialized && reset()) return 1;
+  for(long int k = 0; k < n && !finished(); k++){
+    int status = prepare();
+    if (status == IS_ABORT) return 1;
+    if (status == IS_ROLLBACK) continue;
+    if (notify(t)) return 1;
+    if (advance()) return 1;
+  }
+  return 0;
+}
+
+/**
+ * Advances until the given day (or the end of the simulation)
+ */
+int IS_Model::advance_to(double day){
+  if (!initialized && reset()) return 1;
+  while((t < day*iterPerDay) && !finished()){
+    int status = prepare();
+    if (status == IS_ABORT) return 1;
+    if (status == IS_ROLLBACK) continue;
+    if (notify(t)) return 1;
+    if (advance()) return 1;
+  }
+  return 0;
+}
+
+/**
+ * Computes the tissue integrals of the fields at t and, when due, runs the
+ * health check, so the observers never see a state that is rolled back.
+ * Returns IS_ABORT to stop, IS_ROLLBACK when the state went back to the
+ * last checkpoint, 0 otherwise.
+ */
+int IS_Model::prepare(){
+  int due = health && t%healthEvery == 0;
+  int statsValid = 0;
+
+  if (t > 0 && simCase!=3){ //with diffusion (0,1 e 2)
+    statsValid = due && healthFused;
+    int status = (layout == IS_AOSOA) ? integrate(aosoa, statsValid) : integrate(soa, statsValid);
+    if (status) return IS_ABORT;
+  }
+  return due ? checkHealth(statsValid) : 0;
+}
+
+/**
+ * Tissue integrals of the fields at t, 'fused' also fills fieldStats
+ */
+template<class L>
+int IS_Model::integrate(const L& u, int fused){
+  for(int s = 0; s < IS_SPECIES; s++) integrals[s] = 0.0;
+  if (calcIntegral_lv(u, 2, &integrals[2], fused ? fieldStats[2] : NULL)!=0){
+    cout << "Something went wrong with the integral!!! \n";
+    return 1;
+  }
+  calcIntegral(u, 1, &integrals[1], fused ? fieldStats[1] : NULL);
+  calcIntegral_bv(u, 3, &integrals[3], fused ? fieldStats[3] : NULL);
+  calcIntegral(u, 0, &integrals[0], fused ? fieldStats[0] : NULL);
+  return 0;
+}
+
+/**
+ * Runs the health checks on the fields at t and applies the policy.
+ * Returns IS_ABORT to stop, IS_ROLLBACK when the state went back to the
+ * last checkpoint, 0 otherwise.
+ */
+int IS_Model::checkHealth(int statsValid){
+  IS_View fields = getFields();
+  int failed;
+
+  if (healthFused && statsValid){
+    double sum[IS_SPECIES], min[IS_SPECIES];
+    for(int s = 0; s < IS_SPECIES; s++){
+      sum[s] = fieldStats[s][0];
+      min[s] = fieldStats[s][1];
+    }
+    failed = health->check(fields, sum, min, t);
+  } else {
+    failed = health->check(fields, t);
+  }
+
+  if (!failed){
+    if (health->getPolicy() == IS_ROLLBACK) getCheckpoint(ckpt);
+    return 0;
+  }
+
+  if (health->getPolicy() == IS_WARN){
+    if (health->getFailures() == 1) cout << "Health check failed : " << health->describe(health->getFirst());
+    return 0;
+  }
+  cout << "Health check failed : " << health->describe(health->getLast());
+  if (health->getPolicy() == IS_ABORT || rollbacks >= IS_MAX_ROLLBACKS){
+    cout << "Aborting at iteration " << t << "\n";
+    return IS_ABORT;
+  }
+
+  //back to the last healthy state with half the time step
+  if (setCheckpoint(ckpt)){
+    cout << "No healthy state to roll back to, aborting at iteration " << t << "\n";
+    return IS_ABORT;
+  }
+  rollbacks++;
+  deltaT    /= 2;
+  stepScale *= 2;
+  t          = ckpt.t;
+  observed   = t;
+  cout << "Rolling back to iteration " << t << " with deltaT = " << deltaT << "\n";
+  return IS_ROLLBACK;
+}
 
 /******************************************************************************
 * Solve model equations
 *******************************************************************************/
 int IS_Model::solve(){
 
-  int i       = 0;
-  long int t  = 0;
+  IS_FileObserver files(config.dir, saveFiles, config.dumpEvery);
+  files.setCompression(config.compress, config.absTol, config.relTol);
+  IS_Analytics analytics(config.dir, config.analytics);
+  addObserver(&files, getSnapshotInterval());
+  if (config.analytics) addObserver(&analytics, getSnapshotInterval());
+  IS_Telemetry telemetry(config.telemetry);
+  if (!config.telemetry.empty()) addObserver(&telemetry, 1);
+  IS_Health monitor(config.healthChecks, config.healthPolicy);
+  if (config.healthChecks){
+    setHealthMonitor(&monitor, config.healthEvery ? config.healthEvery : getSnapshotInterval(),
+                     config.healthFused);
+  }
 
   //set initial conditions
-  initialize();
+  if (reset()){
+    removeObserver(&files);
+    removeObserver(&analytics);
+    removeObserver(&telemetry);
+    health = NULL;
+    return 1;
+  }
 
   //print program header
   cout << Header();
+  if (config.numaReport) cout << Placement();
 
-  // memory allocation for filename
-  char *fileName = (char *)malloc(20*sizeof(char));
-  
-  sprintf(fileName, "%s%s", dir, "L.dat");
-  datamatlabL = fopen(fileName, "w");
-    
-  //check valid dir
-  if (checkFile(datamatlabL)) return 1;
-
-  sprintf(fileName, "%s%s", dir, "T.dat");
-  datamatlabT = fopen(fileName, "w");
-
-  sprintf(fileName, "%s%s", dir, "B.dat");
-  datamatlabB = fopen(fileName, "w");
-
-  sprintf(fileName, "%s%s", dir, "P.dat");
-  datamatlabP = fopen(fileName, "w");
+  cout << "Calculating...\n";
 
   /**
    * begin time loop
    */
-  do{
-
-    if (t == 0) cout << "Calculating...\n"; //????
-
-    int value = ((int)iterPerDay*days)/points; //fora do if?
-
-    if(t%value == 0) {
-
-  	  cout << "Saving files : iteration ..."<< t << "\n";
-
-      if (saveFiles){//check before saving all files
-        sprintf(fileName,"%sA_%ld.csv", dir,t);
-        datamatlabA = fopen(fileName, "w");
-   	    sprintf(fileName,"%sMr_%ld.csv",dir,t);
-   	    datamatlabMr = fopen(fileName, "w");
-   	    sprintf(fileName,"%sMa_%ld.csv",dir,t);
-   	    datamatlabMa = fopen(fileName, "w");
-   	    sprintf(fileName,"%sF_%ld.csv",dir,t);
-   	    datamatlabF = fopen(fileName, "w");
-   	    fprintf(datamatlabT, "%ld %.2E \n", t, Th);
-   	    fprintf(datamatlabB, "%ld %.2E \n", t, B);
-   	    fprintf(datamatlabP, "%ld %.2E \n", t, P);
-
-        fprintf(datamatlabL, "%ld %.2E %.2E %.2E %.2E %.2E %.2E\n", t, MA_T, F_T, MA_L, F_L, A_T, MR_T);
-   	    for(int x = 0; x < Xspace; x++) {
-  	      for(int y = 0; y < Yspace; y++) {
-            for(int z = 0; z < Zspace; z++) {
-              if( (x+1 == Xspace && y+1 == Yspace && z+1==Zspace) ) {
-                fprintf(datamatlabA, "%d %d %d %E", x, y, z, A[0][x][y][z]);
-     		        fprintf(datamatlabMr, "%d %d %d %E", x, y, z, MR[0][x][y][z]);
-		            fprintf(datamatlabMa, "%d %d %d %E", x, y, z, MA[0][x][y][z]);
-       		      fprintf(datamatlabF, "%d %d %d %E", x, y, z, F[0][x][y][z]);
-              } else {
-		            fprintf(datamatlabA, "%d %d %d %E\n", x, y, z, A[0][x][y][z]);
-        	      fprintf(datamatlabMr, "%d %d %d %E\n", x, y, z, MR[0][x][y][z]);
-                fprintf(datamatlabMa, "%d %d %d %E\n", x, y, z, MA[0][x][y][z]);
-        	      fprintf(datamatlabF, "%d %d %d %E\n", x, y, z, F[0][x][y][z]);
-	            }
-	          }
-    	    }
-    	  }
-        fclose(datamatlabA);
-        fclose(datamatlabMr);
-        fclose(datamatlabMa);
-        fclose(datamatlabF);
-      }else{
-        fprintf(datamatlabT, "%ld %.2E \n", t, Th);
-   	    fprintf(datamatlabB, "%ld %.2E \n", t, B);
-   	    fprintf(datamatlabP, "%ld %.2E \n", t, P);
-	      fprintf(datamatlabL, "%ld %.2E %.2E %.2E %.2E %.2E %.2E\n", t, MA_T, F_T, MA_L, F_L, A_T, MR_T);	
-	
-        //fprintf(datamatlabL, "%ld %.2E %.2E %.2E %.2E %.2E %.2E \n", t,
-                //MA[0][0][0][0], F[0][0][0][0], MA_L, F_L, A[0][0][0][0],
-                //MR[0][0][0][0]);
-      }
-    }
-  
+  int status = 0;
+  while(!finished() && status == 0){
+    status = step();
+  }
+  if (finish()) status = 1;
+  removeObserver(&files);
+  removeObserver(&analytics);
+  removeObserver(&telemetry);
+  health = NULL;
+  if (status) return 1;
+
+  cout << "teste\n" << Footer(t);
+  return 0;
+}
+
+/**
+ * Computes one step of deltaT, with the tissue integrals of the current
+ * fields when 'integrated'
+ */
+template<class L>
+int IS_Model::advance(const L& u, int integrated){
+
+
     //integral
     //cout << "Solve integrals. ";
-    if (t > 0 && simCase!=3){ //with diffusion (0,1 e 2)
-      MA_T = MR_T = F_T = A_T = 0.0;
-      if (calcIntegral_lv(MA, &MA_T)!=0){
-        cout << "Something went wrong with the integral!!! \n";
-        return 1;
-      }      
-      calcIntegral(MR, &MR_T);
-      calcIntegral_bv(F, &F_T);
-      calcIntegral(A, &A_T);
+    if (integrated && simCase!=3){ //with diffusion (0,1 e 2), computed by integrate()
+      A_T  = integrals[0];
+      MR_T = integrals[1];
+      MA_T = integrals[2];
+      F_T  = integrals[3];
     }
 
 //*****************************************************************************
     //Complete model without diffusion (nao possui termo D*delta)
     if (simCase == 3){
-        A[0][0][0][0] = ( beta_A*A[0][0][0][0]*(1-(A[0][0][0][0]/k_A))
-		      - ( lambda_mr*MR[0][0][0][0]*A[0][0][0][0])
-		      - (lambda_ma* MA[0][0][0][0]* A[0][0][0][0])
-		      - (lambda_afma*F[0][0][0][0]*A[0][0][0][0]*MA[0][0][0][0])
-		      - (lambda_afmr*F[0][0][0][0]*A[0][0][0][0]*MR[0][0][0][0])
-		      - m_A * A[0][0][0][0]) * deltaT + A[0][0][0][0];
+        u(0,0,0,0,0) = ( beta_A*u(0,0,0,0,0)*(1-(u(0,0,0,0,0)/k_A))
+		      - ( lambda_mr*u(1,0,0,0,0)*u(0,0,0,0,0))
+		      - (lambda_ma* u(2,0,0,0,0)* u(0,0,0,0,0))
+		      - (lambda_afma*u(3,0,0,0,0)*u(0,0,0,0,0)*u(2,0,0,0,0))
+		      - (lambda_afmr*u(3,0,0,0,0)*u(0,0,0,0,0)*u(1,0,0,0,0))
+		      - m_A * u(0,0,0,0,0)) * deltaT + u(0,0,0,0,0);
         //A*F
 
-        MR[0][0][0][0] = ((- m_Mr * MR[0][0][0][0])
-		       - (gamma_ma * MR[0][0][0][0] * A[0][0][0][0])       
-		       + alpha_mr * (m_estrela - MR[0][0][0][0])
-            ) * deltaT + MR[0][0][0][0];
+        u(1,0,0,0,0) = ((- m_Mr * u(1,0,0,0,0))
+		       - (gamma_ma * u(1,0,0,0,0) * u(0,0,0,0,0))       
+		       + alpha_mr * (m_estrela - u(1,0,0,0,0))
+            ) * deltaT + u(1,0,0,0,0);
   
 
-        MA[0][0][0][0] = ((-m_Ma * MA[0][0][0][0])
-		       + (gamma_ma * MR[0][0][0][0] * A[0][0][0][0])
+        u(2,0,0,0,0) = ((-m_Ma * u(2,0,0,0,0))
+		       + (gamma_ma * u(1,0,0,0,0) * u(0,0,0,0,0))
 		       - alpha_Ma * (MA_T - MA_L)
-			     ) * deltaT + MA[0][0][0][0];
+			     ) * deltaT + u(2,0,0,0,0);
 
-        F[0][0][0][0] = (- (lambda_afma * F[0][0][0][0]* A[0][0][0][0]*MA[0][0][0][0])
-          - (lambda_afmr*F[0][0][0][0]*A[0][0][0][0]*MR[0][0][0][0])
+        u(3,0,0,0,0) = (- (lambda_afma * u(3,0,0,0,0)* u(0,0,0,0,0)*u(2,0,0,0,0))
+          - (lambda_afmr*u(3,0,0,0,0)*u(0,0,0,0,0)*u(1,0,0,0,0))
 		      - (alpha_f * (F_T - F_L))
-			    )* deltaT + F[0][0][0][0];
+			    )* deltaT + u(3,0,0,0,0);
         //FL-F?
 
-        MA_L = ( alpha_Ma * (MA_T - MA_L)) * deltaT + MA_L;
-        if (MA_L < 0.0) MA_L = 0.0;
-        //VLV e VLN?
-
-        Th = (b_th*(ro_t*Th*MA_L -Th*MA_L) -b_p*MA_L*Th*B
-          + alpha_t*(t_estrela - Th)) * deltaT + Th;
-        if (Th < 0.0) Th = t_estrela;
-
-        B = (b_pb*(ro_b*Th*MA_L-Th*MA_L*B)
-          + alpha_b*(b_estrela - B)) * deltaT + B;
-        if (B < 0.0) B = b_estrela;
-
-        P = (b_pp*(ro_p*Th*MA_L*B) + alpha_p*(p_estrela - P)) * deltaT + P;
-        if (P < 0.0) P = p_estrela;
-
-        F_L = (ro_f*P + alpha_f*(F_T-F_L)) * deltaT + F_L;
-        if (F_L < 0.0) F_L = f_estrela;
-        //FT-FL?
+        IS_LymphNode(par, deltaT, MA_T, F_T, MA_L, Th, B, P, F_L);
     }
 //*****************************************************************************
     else{
       //Solve ODEs    
       if(simCase==0){
-        MA_L = ( alpha_Ma * (MA_T - MA_L)) * deltaT + MA_L;
-        if (MA_L < 0.0) MA_L = 0.0;
-
-        Th = (b_th*(ro_t*Th*MA_L -Th*MA_L) -b_p*MA_L*Th*B
-          + alpha_t*(t_estrela - Th)) * deltaT + Th;
-        if (Th < 0.0) Th = t_estrela;
-
-        B = (b_pb*(ro_b*Th*MA_L-Th*MA_L*B)
-           + alpha_b*(b_estrela - B)) * deltaT + B;
-        if (B < 0.0) B = b_estrela;
-
-        P = (b_pp*(ro_p*Th*MA_L*B) + alpha_p*(p_estrela - P)) * deltaT + P;
-        if (P < 0.0) P = p_estrela;
-
-        F_L = (ro_f*P + alpha_f*(F_T-F_L)) * deltaT + F_L;
-        if (F_L < 0.0) F_L = f_estrela;
+        IS_LymphNode(par, deltaT, MA_T, F_T, MA_L, Th, B, P, F_L);
     }
 
-    //Solve PDEs
+    //Solve PDEs (x planes split among the threads as in IS_AllocField)
+    #pragma omp parallel for schedule(static)
     for(int x = 0; x < Xspace; x++) {
       for(int y = 0; y < Yspace; y++) {
 	      for(int z = 0; z < Zspace; z++) {
+            double source_mr;
 //*****************************************************************************
           //Simulates only antigen diffusion (nao tem lambdas)
 	        if(simCase==1){
 		
 	          //Antigenos
-	          A[1][x][y][z] = ( beta_A*A[0][x][y][z]*(1-(A[0][x][y][z]/k_A)) 
-	            + (d_a * laplacian(A,x,y,z))
-		          - m_A * A[0][x][y][z]) * deltaT + A[0][x][y][z];
+	          u(0,1,x,y,z) = ( beta_A*u(0,0,x,y,z)*(1-(u(0,0,x,y,z)/k_A)) 
+	            + (d_a * laplacian(u,0,x,y,z))
+		          - m_A * u(0,0,x,y,z)) * deltaT + u(0,0,x,y,z);
               
 
-	          if(A[1][x][y][z] != A[1][x][y][z]) {
-	             cout << "A\t(NaN)-> i:"<<i<<"\t-> ("<< x << y << z << ")" << A[1][x][y][z] << "\n";
-	            //  return 1;
-	          }
 //*****************************************************************************
 	        //Simulates only innate response(equação completa)
 	        }else if (simCase==2){
 
             //Antigenos
-	          A[1][x][y][z] = ( beta_A*A[0][x][y][z]*(1-(A[0][x][y][z]/k_A))
-	           - ( lambda_mr*MR[0][x][y][z]*A[0][x][y][z])
-			       - (lambda_ma*MA[0][x][y][z]*A[0][x][y][z])
-			       - m_A * A[0][x][y][z]
-			       + (d_a * laplacian(A,x,y,z))
-			       ) * deltaT + A[0][x][y][z];
-
-	          if(A[1][x][y][z] != A[1][x][y][z]) {
-	            cout << "A\t(NaN)-> i:"<<i<<"\t-> ("<< x << y << z << ")" << A[1][x][y][z]<< "\n";
-	          //  return 1;
-	          }
+	          u(0,1,x,y,z) = ( beta_A*u(0,0,x,y,z)*(1-(u(0,0,x,y,z)/k_A))
+	           - ( lambda_mr*u(1,0,x,y,z)*u(0,0,x,y,z))
+			       - (lambda_ma*u(2,0,x,y,z)*u(0,0,x,y,z))
+			       - m_A * u(0,0,x,y,z)
+			       + (d_a * laplacian(u,0,x,y,z))
+			       ) * deltaT + u(0,0,x,y,z);
+
 
             //Macrophages     
             
@@ -607,132 +1012,62 @@ int IS_Model::solve(){
           ******************************************************************/
 	        source_mr = 0;            
 	        if (((bv==0)&&(x==0))||(bv==1)||((bv==2)&&(is_bvase(x,y,z))))    
-	          source_mr = alpha_mr * (m_estrela - MR[0][x][y][z]);
+	          source_mr = alpha_mr * (m_estrela - u(1,0,x,y,z));
 	        /*****************************************************************/             
 	    
-	        MR[1][x][y][z] = ((- m_Mr * MR[0][x][y][z])
-	          - (gamma_ma * MR[0][x][y][z] * A[0][x][y][z])
-			      + (d_mr * laplacian(MR,x,y,z))
-			      + source_mr ) * deltaT + MR[0][x][y][z];
+	        u(1,1,x,y,z) = ((- m_Mr * u(1,0,x,y,z))
+	          - (gamma_ma * u(1,0,x,y,z) * u(0,0,x,y,z))
+			      + (d_mr * laplacian(u,1,x,y,z))
+			      + source_mr ) * deltaT + u(1,0,x,y,z);
 	   
-	        if(MR[1][x][y][z] != MR[1][x][y][z] ) {
-	          cout << "MR\t(NaN)-> i: " << i << "-> "<< MR[1][x][y][z] <<"(" << x << y << z << ")" << "\n";
-	          // return 1;
-	        }
 
-	        MA[1][x][y][z] = ((-m_Ma * MA[0][x][y][z])
-	         + (gamma_ma * MR[0][x][y][z] * A[0][x][y][z])
-			     + (d_ma * laplacian(MA,x,y,z))
-			     ) * deltaT + MA[0][x][y][z];
+	        u(2,1,x,y,z) = ((-m_Ma * u(2,0,x,y,z))
+	         + (gamma_ma * u(1,0,x,y,z) * u(0,0,x,y,z))
+			     + (d_ma * laplacian(u,2,x,y,z))
+			     ) * deltaT + u(2,0,x,y,z);
 	   
-	        if(MA[1][x][y][z] != MA[1][x][y][z] ) {
-	          cout << "MA\t(NaN)-> i: " << i << "-> "<< MA[1][x][y][z] <<"(" << x << y << z << ")"<< "\n" ;
-	          //  return 1;
-	        }
 //*****************************************************************************
 
 	        //Simulates complete model
           }else if(simCase==0){
-	          //Antigenos
-            A[1][x][y][z] = ( beta_A*A[0][x][y][z]*(1-(A[0][x][y][z]/k_A))
-	            - ( lambda_mr*MR[0][x][y][z]*A[0][x][y][z])
-		          - ( lambda_ma * MA[0][x][y][z] * A[0][x][y][z])
-		          - ( lambda_afma*F[0][x][y][z]*A[0][x][y][z]*MA[0][x][y][z])
-              - ( lambda_afmr*F[0][x][y][z]*A[0][x][y][z]*MR[0][x][y][z])
-		          - m_A * A[0][x][y][z]
-		          + (d_a * laplacian(A,x,y,z))
-		          ) * deltaT + A[0][x][y][z];
-           
-	          if(A[1][x][y][z] < tol) {A[1][x][y][z] = 0.0;} 
-            
-            if(A[1][x][y][z] != A[1][x][y][z]) {
-              cout << "A\t(NaN)-> i:"<<i<<" -> ("<< x << y << z << ") ->" << A[1][x][y][z] << "\n";
-	            //   return 1;
-            }
-
-            //Macrophages
-            
-	          /*****************************************************************
-	          * Assuming: contact with blood vessels only on one border bv = 0
-	          *           homogeneous contact with blood vessels bv = 1   
-	          *           contact with blood vessels given by function bv = 2
-	          ******************************************************************/
-	          source_mr = 0;            
-	          if (((bv==0)&&(x==0))||(bv==1)||((bv==2)&&(is_bvase(x,y,z))))    
-	            source_mr = alpha_mr * (m_estrela - MR[0][x][y][z]);
-	          /*****************************************************************/  
-	    
-	          MR[1][x][y][z] = ((- m_Mr * MR[0][x][y][z])
-	           - (gamma_ma * MR[0][x][y][z] * A[0][x][y][z])       
-	           + (d_mr * laplacian(MR,x,y,z))
-		         + source_mr ) * deltaT + MR[0][x][y][z];
-
-	          if(MR[1][x][y][z] != MR[1][x][y][z] ) {
-	            cout << "MR\t(NaN)-> i: " << i << "-> "<< MR[1][x][y][z] <<"(" << x << y << z << ")" << "\n";
-	            // return 1;
-	          }
-
-	          /*****************************************************************
-	          * Assuming: contact with lymph vessels only on one border bv = 0
-	          *           homogeneous contact with lymph vessels bv = 1   
-	          *           contact with lymph vessels given by function bv = 2
-	          ******************************************************************/
-	          migration_ma = 0;            
-	          if (((lnv==0)&&(x==0))||(lnv==1)||((lnv==2)&&(is_lnvase(x,y,z))))    
-	            migration_ma = alpha_Ma * (MA_T - MA_L);
-	          /*****************************************************************/ 
-	    
-	          MA[1][x][y][z] = ((-m_Ma * MA[0][x][y][z])
-	            + (gamma_ma * MR[0][x][y][z] * A[0][x][y][z])
-	            + (d_ma * laplacian(MA,x,y,z))
-	            - migration_ma ) * deltaT + MA[0][x][y][z];
-          
-            if(MA[1][x][y][z] != MA[1][x][y][z] ) {
-	            cout << "MA\t(NaN)-> i: " << i << "-> "<< MA[1][x][y][z] <<" -> (" << x << y << z << ")" << "\n";
-	            //   return 1;
-            }
-	          //Antibody
-	    
-	          /*****************************************************************
-	          * Assuming: contact with lymph vessels only on one border bv = 0
-	          *           homogeneous contact with lymph vessels bv = 1   
-	          *           contact with lymph vessels given by function bv = 2
-	          ******************************************************************/
-	          migration_f = 0;            
-	          //if (((lnv==0)&&(x==0))||(lnv==1)||((lnv==2)&&(is_lnvase(x,y,z))))    
-	          if (((bv==0)&&(x==0))||(bv==1)||((bv==2)&&(is_bvase(x,y,z))))
-	            migration_f = (alpha_f * (F_T - F_L));
-	          /*****************************************************************/ 
-	    
-	          F[1][x][y][z] = (
-	            - ( lambda_afma * F[0][x][y][z] * A[0][x][y][z]*MA[0][x][y][z])
-	            - ( lambda_afmr*F[0][x][y][z]*A[0][x][y][z]*MR[0][x][y][z])
-			        - migration_f + (d_f * laplacian(F,x,y,z))
-			        )* deltaT + F[0][x][y][z];
-
-			      if(F[1][x][y][z] != F[1][x][y][z] ) {
-	            cout << "F\t(NaN)-> i: " << i << "-> "<< F[1][x][y][z] <<"(" << x << y << z << ")"<< "\n" ;
-	          //  return 1;
-            }
+            IS_CoupledPoint(par, deltaT, tol,
+              u(0,0,x,y,z), u(1,0,x,y,z), u(2,0,x,y,z), u(3,0,x,y,z),
+              laplacian(u,0,x,y,z), laplacian(u,1,x,y,z), laplacian(u,2,x,y,z), laplacian(u,3,x,y,z),
+              bloodContact(x,y,z), lymphContact(x,y,z), MA_T, MA_L, F_T, F_L,
+              u(0,1,x,y,z), u(1,1,x,y,z), u(2,1,x,y,z), u(3,1,x,y,z));
 	        }
         }
       }
     }
 
     //atualiza variaveis necessarias em cada caso
-    update(A);
-    if(simCase==2||simCase==0){
-      update(MR);
-      update(MA);
-    }
     if(simCase==0){
-      update(F);
+      update(u, 4);      //A, MR, MA, F
+    }else if(simCase==2){
+      update(u, 3);      //A, MR, MA
+    }else{
+      update(u, 1);      //A
     }
   }
-  t++;
-
-}while((t < (iterPerDay*days)) && (A_T > tol));
+  return 0;
+}
 
-  cout << "teste\n" << Footer(t);
+/**
+ * Computes time step t to t+1 with the layout of the run, in stepScale
+ * steps of deltaT after rollbacks (the integrals of the first one come
+ * from prepare())
+ */
+int IS_Model::advance(){
+  for(long int k = 0; k < stepScale; k++){
+    int integrated = (t > 0 || k > 0);
+    int status;
+    if (layout == IS_AOSOA){
+      status = (k > 0 && simCase!=3 && integrate(aosoa, 0)) || advance(aosoa, integrated);
+    } else {
+      status = (k > 0 && simCase!=3 && integrate(soa, 0)) || advance(soa, integrated);
+    }
+    if (status) return 1;
+  }
+  t++;
   return 0;
 }
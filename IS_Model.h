@@ -8,28 +8,119 @@
 #include <time.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <vector>
+#include <map>
+
+//points per side, other sizes with -DIS_GRID=n (see bench.cpp)
+#ifndef IS_GRID
+#define IS_GRID 10
+#endif
 
 //condições iniciais do pedaço de tecido
 //each 10 space equals 1 cm (1 × 10^−2 m)
-const int    Xspace   = 10.0; // 10 mm = 1 cm
-const int    Yspace   = 10.0; // 10 mm = 1 cm
-const int    Zspace   = 10.0; // 10 mm = 1 cm
+const int    Xspace   = IS_GRID; // 10 mm = 1 cm
+const int    Yspace   = IS_GRID; // 10 mm = 1 cm
+const int    Zspace   = IS_GRID; // 10 mm = 1 cm
 const int    SPACE    = Xspace * Yspace * Zspace; // 1 cm^3
 const int    IC_SPACE = 0.4*(Xspace * Yspace * Zspace); //initial condition
 const int    source   = 100*pow(10,0);
 const double SCALE    = pow(10,-3);
 const double MOL      = 6.02*pow(10,23);
 const int    buffer   = 2;
+const int    IS_SPECIES = 4; //A, MR, MA, F
+
+//changed with the equations or constants, invalidates the IS_Cache entries
+#define IS_MODEL_VERSION "1.0"
+
+#include "IS_Equations.h"
+#include "IS_Layout.h"
+
+class IS_Model;
+class IS_Health;
+
+/**
+ * Simulation definitions, typed version of the simdefs[] array
+ */
+struct IS_Config{
+  int simCase;       //0 coupled, 1 antigen diffusion, 2 innate response, 3 no diffusion
+  int saveFiles;     //0 saves only edos files, 1 saves all files
+  int days;          //number of days simulated
+  int points;        //number of files saved
+  int lnv;           //contact with lymph vessels (0 border, 1 homogeneous, 2 function)
+  int bv;            //contact with blood vessels (0 border, 1 homogeneous, 2 function)
+  double deltaT;     //intervalo de tempo
+  double iterPerDay; //numero de iterações por dia
+  std::string dir;   //output directory
+  int dumpEvery;     //fields saved every dumpEvery points (with saveFiles)
+  int analytics;     //reductions computed at each point (IS_Analytics flags)
+  int compress;      //fields saved as 0 csv, 1 lossless .isz, 2 lossy .isz
+  double absTol[IS_SPECIES]; //lossy compression absolute error of A, MR, MA, F
+  double relTol[IS_SPECIES]; //or relative to the field maximum when absTol is 0
+  int healthChecks;  //numerical checks done by solve() (IS_Health flags)
+  int healthPolicy;  //what to do when a check fails (IS_WARN, IS_ABORT, IS_ROLLBACK)
+  int healthEvery;   //time steps between checks, 0 checks at every point
+  int healthFused;   //1 takes the sums from the integral pass
+  int hugePages;     //1 asks for transparent huge pages for the fields; a 2MB page
+                     //lands on the node of the first thread touching it, so
+                     //threads whose x planes share a page (planes under 2MB,
+                     //grids below 512x512 in y,z) lose the NUMA first touch placement
+  int pinThreads;    //1 pins each OpenMP thread to a core, once per process (IS_PinThreads)
+  int numaReport;    //1 prints the NUMA node of the field pages at startup
+  std::string telemetry; //shared memory name of the live values ("" none, see IS_Telemetry)
+  int layout;        //field storage, IS_SOA or IS_AOSOA (IS_Layout.h)
+  std::map<std::string, double> params; //values replacing the defaults of IS_Model::getParams
+
+  IS_Config();
+  IS_Config(double simdefs[]);
+};
+
+/**
+ * Tissue integrals and lymph node values at the current step
+ */
+struct IS_Scalars{
+  double A_T, MA_T, MR_T, F_T;
+  double MA_L, Th, B, P, F_L;
+};
+
+/**
+ * Complete state of the model at time step t: the current time level of
+ * A, MR, MA and F (SPACE values each, [x][y][z] order) and the scalars
+ */
+struct IS_Checkpoint{
+  long int t;
+  IS_Scalars scalars;
+  std::vector<double> fields;
+};
+
+/**
+ * Receives the model state every 'interval' time steps. Observers are
+ * called before the step is computed and after the health check, so the
+ * fields are the healthy ones at time step t and the integrals the ones
+ * computed at t-1. Returning non zero stops the simulation.
+ */
+class IS_Observer{
+  public:
+    virtual ~IS_Observer(){}
+    virtual int begin(const IS_Model& model){ return 0; }
+    virtual int observe(const IS_Model& model, long int t) = 0;
+    virtual int end(const IS_Model& model, long int t){ return 0; }
+};
 
 class IS_Model{
 
   private:
 
-    double A [buffer][Xspace][Yspace][Zspace];  //S. aureus Bacteria
-    double MR [buffer][Xspace][Yspace][Zspace]; //Resting Macrophages
-    double MA [buffer][Xspace][Yspace][Zspace];  //Activated Macrophages
-    double F [buffer][Xspace][Yspace][Zspace];  //Antigens
+    //[buffer][Xspace][Yspace][Zspace] arrays, see IS_AllocField (IS_SOA only)
+    double (*A)[Xspace][Yspace][Zspace];  //S. aureus Bacteria
+    double (*MR)[Xspace][Yspace][Zspace]; //Resting Macrophages
+    double (*MA)[Xspace][Yspace][Zspace]; //Activated Macrophages
+    double (*F)[Xspace][Yspace][Zspace];  //Antigens
+    double* U;        //interleaved A, MR, MA, F (IS_AOSOA only)
+    int layout;
+    IS_SoA soa;
+    IS_AoSoA aosoa;
 
+    IS_Config config;
     int simCase;
     int days;
     int points;
@@ -40,9 +131,6 @@ class IS_Model{
     int lnv;  //volume do linfonodo
     int bv; //blood vessels
     double tol;
-    double source_mr;
-    double migration_ma; //migração macrófagos
-    double migration_f;   //migração antigens
 
     //Initial values of the coupled model (parameters)
     double m0;
@@ -91,39 +179,83 @@ class IS_Model{
     double alpha_p;
     double alpha_f;
     double alpha_mr;
+    IS_Params<double> par; //same values, used by the equations in IS_Equations.h
     
 
     int saveFiles;
-    char *dir;
-    FILE* datamatlabA;
-    FILE* datamatlabMr;
-    FILE* datamatlabMa;
-    FILE* datamatlabT;
-    FILE* datamatlabB;
-    FILE* datamatlabP;
-    FILE* datamatlabF;
-    FILE* datamatlabL;
+    long int t;       //current time step
+    int initialized;  //initial conditions set for the current run
+
+    std::vector<IS_Observer*> observers;
+    std::vector<long int> intervals;
+    long int stepScale;  //steps of deltaT per time step (deltaT halved by rollbacks)
+
+    IS_Health* health;
+    long int healthEvery;
+    int healthFused;
+    double fieldStats[IS_SPECIES][2]; //sum and minimum from the integral pass
+    double integrals[IS_SPECIES];     //tissue integrals at t, applied by advance()
+    IS_Checkpoint ckpt;               //last healthy state, for rollbacks
+    int rollbacks;
+    int allocFailed;                  //fields not allocated, reported once by reset()
+    long int observed;                //last time step given to the observers
 
     std::string Header();
     std::string Footer(long int t);
-    int checkFile(FILE* theFile);
-    int calcIntegral(double vec[][Xspace][Yspace][Zspace], double *V);
-    int calcIntegral_lv(double vec[][Xspace][Yspace][Zspace], double *V);
-    int calcIntegral_bv(double vec[][Xspace][Yspace][Zspace], double *V);
+    int notify(long int t);
+    int prepare();
+    template<class L> int integrate(const L& u, int fused);
+    int advance();
+    template<class L> int advance(const L& u, int integrated);
+    double& at(int s, int x, int y, int z);
+    int checkHealth(int fused);
+    IS_Model(const IS_Model&);
+    IS_Model& operator=(const IS_Model&);
+    template<class L> int calcIntegral(const L& u, int s, double *V, double *stats = NULL);
+    template<class L> int calcIntegral_lv(const L& u, int s, double *V, double *stats = NULL);
+    template<class L> int calcIntegral_bv(const L& u, int s, double *V, double *stats = NULL);
     void initialize();
-    void update(double vec[][Xspace][Yspace][Zspace]);
-    double laplacian(double vec[][Xspace][Yspace][Zspace], int x, int y, int z);
-    int is_bvase(int x, int y, int z);
-    int is_lnvase(int x, int y, int z);
+    template<class L> void update(const L& u, int species);
+    template<class L> double laplacian(const L& u, int s, int x, int y, int z);
 
   public:
     IS_Model(double simdefs[]);
+    IS_Model(const IS_Config& cfg);
     //IS_Model(int sCase, int sFile);
-    //~IS_Model();
+    ~IS_Model();
     void setSaveFiles(int sf);
     void setSimulationCase(int sc);
     int solve();
 
+    //stepping API
+    int reset();
+    int step(long int n = 1);
+    int advance_to(double day);
+    int finish();
+    int finished() const;
+    void addObserver(IS_Observer* obs, long int interval);
+    void removeObserver(IS_Observer* obs);
+    void setHealthMonitor(IS_Health* monitor, long int every, int fused = 0);
+
+    IS_View getFields() const;
+    IS_Scalars getScalars() const;
+    void getCheckpoint(IS_Checkpoint& c) const;
+    int setCheckpoint(const IS_Checkpoint& c);
+    const IS_Config& getConfig() const { return config; }
+    long int getStep() const { return t; }
+    double getDay() const { return t/iterPerDay; }
+    double getDeltaT() const { return deltaT; }
+    long int getSnapshotInterval() const;
+    std::string Placement() const;
+    IS_Params<double> getParams() const;
+    static IS_Params<double> getParams(const IS_Config& cfg);
+    static int is_bvase(int x, int y, int z);
+    static int is_lnvase(int x, int y, int z);
+    int bloodContact(int x, int y, int z) const;
+    int lymphContact(int x, int y, int z) const;
+    static int bloodContact(int bv, int x, int y, int z);
+    static int lymphContact(int lnv, int x, int y, int z);
+
 };
 
 #endif
@@ -0,0 +1,136 @@
+#include "IS_Numa.h"
+#include <string.h>
+#include <map>
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/******************************************************************************
+ * 
+ * IS_Numa - NUMA aware allocation of the fields.
+ * 
+ * Fields are mapped with mmap (optionally with transparent huge pages) and
+ * zeroed by the threads that will compute them. Thread pinning and the
+ * placement report need Linux, elsewhere the fields are simply allocated
+ * and zeroed in parallel.
+ * 
+ ******************************************************************************/
+
+using namespace std;
+
+static const size_t FIELD_BYTES = sizeof(double)*buffer*SPACE;
+static const size_t HUGE_PAGE   = 2*1024*1024;
+
+/**
+ * Size of the mapping, rounded to whole (huge) pages
+ */
+static size_t mappedBytes(size_t bytes){
+  return ((bytes + HUGE_PAGE - 1)/HUGE_PAGE)*HUGE_PAGE;
+}
+
+void* IS_AllocPlanes(size_t planeBytes, int levels, int hugePages){
+  size_t bytes = planeBytes*Xspace*levels;
+  void* p;
+#ifdef __linux__
+  p = mmap(NULL, mappedBytes(bytes), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) return NULL;
+#ifdef MADV_HUGEPAGE
+  if (hugePages) madvise(p, mappedBytes(bytes), MADV_HUGEPAGE);
+#endif
+#else
+  p = malloc(bytes);
+  if (p == NULL) return NULL;
+#endif
+
+  //first touch
+  for(int b = 0; b < levels; b++){
+    char* level = (char*)p + b*planeBytes*Xspace;
+    #pragma omp parallel for schedule(static)
+    for(int x = 0; x < Xspace; x++){
+      memset(level + x*planeBytes, 0, planeBytes);
+    }
+  }
+  return p;
+}
+
+void IS_FreePlanes(void* p, size_t planeBytes, int levels){
+  if (p == NULL) return;
+#ifdef __linux__
+  munmap(p, mappedBytes(planeBytes*Xspace*levels));
+#else
+  free(p);
+#endif
+}
+
+IS_Buffer IS_AllocField(int hugePages){
+  return (IS_Buffer)IS_AllocPlanes(FIELD_BYTES/(buffer*Xspace), buffer, hugePages);
+}
+
+void IS_FreeField(IS_Buffer field){
+  IS_FreePlanes((void*)field, FIELD_BYTES/(buffer*Xspace), buffer);
+}
+
+static int pinThreads(){
+  int pinned = 0;
+#if defined(__linux__) && defined(_OPENMP)
+  cpu_set_t allowed;
+  vector<int> cores;
+
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return 0;
+  for(int c = 0; c < CPU_SETSIZE; c++){
+    if (CPU_ISSET(c, &allowed)) cores.push_back(c);
+  }
+  if (cores.empty()) return 0;
+
+  #pragma omp parallel reduction(+:pinned)
+  {
+    cpu_set_t mine;
+    CPU_ZERO(&mine);
+    CPU_SET(cores[omp_get_thread_num() % cores.size()], &mine);
+    if (sched_setaffinity(0, sizeof(mine), &mine) == 0) pinned = 1;
+  }
+#endif
+  return pinned;
+}
+
+int IS_PinThreads(){
+  static int pinned = -1;
+  int result;
+  #pragma omp critical(IS_PinThreads)
+  {
+    if (pinned < 0) pinned = pinThreads();
+    result = pinned;
+  }
+  return result;
+}
+
+std::string IS_Placement(const void* field, size_t bytes){
+  std::ostringstream sstream;
+#if defined(__linux__) && defined(SYS_move_pages)
+  long pageSize = sysconf(_SC_PAGESIZE);
+  size_t npages = (bytes + pageSize - 1)/pageSize;
+  vector<void*> pages(npages);
+  vector<int> status(npages, -1);
+  map<int, long> count;
+
+  for(size_t i = 0; i < npages; i++) pages[i] = (char*)field + i*pageSize;
+  //with no target nodes move_pages only reports where each page is
+  if (syscall(SYS_move_pages, 0, npages, &pages[0], NULL, &status[0], 0) != 0)
+    return "unknown";
+  for(size_t i = 0; i < npages; i++) count[status[i]]++;
+  for(map<int, long>::iterator it = count.begin(); it != count.end(); ++it){
+    if (it != count.begin()) sstream << " ";
+    if (it->first < 0) sstream << "not mapped: " << it->second;
+    else sstream << "node " << it->first << ": " << it->second;
+  }
+#else
+  sstream << "unknown";
+#endif
+  return sstream.str();
+}
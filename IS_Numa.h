@@ -0,0 +1,45 @@
+#ifndef _IS_Numa_H_
+#define _IS_Numa_H_
+
+#include "IS_Model.h"
+
+/**
+ * Field with both time levels, as used by IS_Model
+ */
+typedef double (*IS_Buffer)[Xspace][Yspace][Zspace];
+
+/**
+ * Allocates the [buffer][Xspace][Yspace][Zspace] array of a species.
+ * The pages are first touched in parallel with the same split of the x
+ * planes among threads as the solver loops (schedule(static)), so each
+ * page lands on the NUMA node of the thread that computes it.
+ * With hugePages the unit of placement is a 2MB page: it goes to the node
+ * of whichever thread touches it first, which is only the right one when
+ * the planes of each thread fill whole huge pages.
+ */
+IS_Buffer IS_AllocField(int hugePages);
+void IS_FreeField(IS_Buffer field);
+
+/**
+ * Same for any storage made of 'levels' blocks of Xspace planes of
+ * planeBytes each (the interleaved layout of IS_Layout.h)
+ */
+void* IS_AllocPlanes(size_t planeBytes, int levels, int hugePages);
+void IS_FreePlanes(void* p, size_t planeBytes, int levels);
+
+/**
+ * Pins each OpenMP thread to one of the cores the process may run on,
+ * returns the number of threads pinned (0 if not supported).
+ * Only the first call pins (the later ones return its result), and the
+ * threads stay pinned until the process exits: the affinity the caller
+ * had is not restored. Call it from serial code, a call from inside a
+ * parallel region pins only the calling thread.
+ */
+int IS_PinThreads();
+
+/**
+ * Number of pages of the field on each NUMA node, e.g. "node 0: 12 node 1: 12"
+ */
+std::string IS_Placement(const void* field, size_t bytes = sizeof(double)*buffer*SPACE);
+
+#endif
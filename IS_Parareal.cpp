@@ -0,0 +1,251 @@
+#include "IS_Parareal.h"
+#include "IS_FileObserver.h"
+#include <sys/time.h>
+
+/******************************************************************************
+ * 
+ * IS_Parareal - parallel in time driver of IS_Model.
+ * 
+ * Use-me : 
+ * 
+ *          IS_Parareal parareal(config, 16);  // 16 time slices
+ *          parareal.setSerialRun(1);          // measured speedup
+ *          parareal.solve();
+ * 
+ *          The slices are solved by OpenMP threads, 'Parareal.dat' gets
+ *          the convergence and speedup of each iteration.
+ * 
+ ******************************************************************************/
+
+using namespace std;
+
+static double wallTime(){
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+/**
+ * out = b + (a - c), exactly b when a and c are equal
+ */
+static void combine(const IS_Checkpoint& a, const IS_Checkpoint& b, const IS_Checkpoint& c,
+                    IS_Checkpoint& out){
+  out.t = a.t;
+  out.fields.resize(a.fields.size());
+  for(size_t i = 0; i < a.fields.size(); i++)
+    out.fields[i] = b.fields[i] + (a.fields[i] - c.fields[i]);
+  out.scalars.A_T  = b.scalars.A_T + (a.scalars.A_T - c.scalars.A_T);
+  out.scalars.MA_T = b.scalars.MA_T + (a.scalars.MA_T - c.scalars.MA_T);
+  out.scalars.MR_T = b.scalars.MR_T + (a.scalars.MR_T - c.scalars.MR_T);
+  out.scalars.F_T  = b.scalars.F_T + (a.scalars.F_T - c.scalars.F_T);
+  out.scalars.MA_L = b.scalars.MA_L + (a.scalars.MA_L - c.scalars.MA_L);
+  out.scalars.Th   = b.scalars.Th + (a.scalars.Th - c.scalars.Th);
+  out.scalars.B    = b.scalars.B + (a.scalars.B - c.scalars.B);
+  out.scalars.P    = b.scalars.P + (a.scalars.P - c.scalars.P);
+  out.scalars.F_L  = b.scalars.F_L + (a.scalars.F_L - c.scalars.F_L);
+}
+
+/**
+ * Largest change between two states, relative to the largest value
+ * (infinite if there are NaN values)
+ */
+static double defect(const IS_Checkpoint& a, const IS_Checkpoint& b){
+  double diff = 0.0, norm = 0.0;
+  const IS_Scalars& x = a.scalars;
+  const IS_Scalars& y = b.scalars;
+  double sa[9] = {x.A_T, x.MA_T, x.MR_T, x.F_T, x.MA_L, x.Th, x.B, x.P, x.F_L};
+  double sb[9] = {y.A_T, y.MA_T, y.MR_T, y.F_T, y.MA_L, y.Th, y.B, y.P, y.F_L};
+  for(size_t i = 0; i < a.fields.size(); i++){
+    if (isnan(a.fields[i]) || isnan(b.fields[i])) return INFINITY;
+    diff = fmax(diff, fabs(a.fields[i] - b.fields[i]));
+    norm = fmax(norm, fabs(a.fields[i]));
+  }
+  for(int i = 0; i < 9; i++){
+    if (isnan(sa[i]) || isnan(sb[i])) return INFINITY;
+    diff = fmax(diff, fabs(sa[i] - sb[i]));
+    norm = fmax(norm, fabs(sa[i]));
+  }
+  return (norm > 0.0) ? diff/norm : diff;
+}
+
+IS_Parareal::IS_Parareal(const IS_Config& cfg, int slices, int ratio){
+  this->config     = cfg;
+  this->slices     = (slices < 1) ? 1 : slices;
+  this->ratio      = (ratio < 1) ? 1 : ratio;
+  this->tol        = pow(10,-6);
+  this->maxIter    = this->slices;
+  this->serialRun  = 0;
+  this->coarse     = NULL;
+
+  //slices start at multiples of the coarse time step
+  long int steps = (long int)(cfg.iterPerDay*cfg.days);
+  for(int n = 0; n <= this->slices; n++){
+    long int b = (long int)((double)n*steps/this->slices/this->ratio + 0.5)*this->ratio;
+    bounds.push_back((n == this->slices) ? steps : b);
+  }
+  series.resize(this->slices);
+  for(int n = 0; n < this->slices; n++){
+    fine.push_back(new IS_Model(cfg));
+    fine[n]->addObserver(&series[n], fine[n]->getSnapshotInterval());
+  }
+}
+
+IS_Parareal::~IS_Parareal(){
+  for(size_t n = 0; n < fine.size(); n++) delete fine[n];
+  delete coarse;
+}
+
+/**
+ * Setters
+ */
+void IS_Parareal::setTolerance(double tol, int maxIter){
+  this->tol     = tol;
+  this->maxIter = maxIter;
+}
+void IS_Parareal::setSerialRun(int run){
+  this->serialRun = run;
+}
+
+/**
+ * Fine solver on slice n
+ */
+int IS_Parareal::propagateFine(int n, const IS_Checkpoint& in, IS_Checkpoint& out){
+  IS_Model* model = fine[n];
+  series[n].clear();
+  if (model->setCheckpoint(in)) return 1;
+  if (model->step(bounds[n+1] - bounds[n])) return 1;
+  model->getCheckpoint(out);
+  //if the bacteria is gone the model stops, as the sequential run does
+  out.t = bounds[n+1];
+  return 0;
+}
+
+/**
+ * Coarse solver on slice n, time steps of the coarse model are 'ratio'
+ * fine time steps
+ */
+int IS_Parareal::propagateCoarse(int n, const IS_Checkpoint& in, IS_Checkpoint& out){
+  IS_Checkpoint c = in;
+  c.t = in.t/ratio;
+
+  if (coarse->setCheckpoint(c)) return 1;
+  if (coarse->step((bounds[n+1] - bounds[n])/ratio)) return 1;
+  coarse->getCheckpoint(out);
+  out.t = bounds[n+1];
+  return 0;
+}
+
+/**
+ * Time series of the fine solution. Slices before the last iteration are
+ * exact, the others were solved from boundary states within 'tol' of the
+ * final ones.
+ */
+int IS_Parareal::writeSeries(){
+  IS_FileObserver files(config.dir, 0);
+
+  if (files.begin(*fine[0])) return 1;
+  for(int n = 0; n < slices; n++){
+    for(size_t i = 0; i < series[n].t.size(); i++){
+      if (files.write(series[n].t[i], series[n].scalars[i])) return 1;
+    }
+  }
+  return files.end(*fine[0], bounds[slices]);
+}
+
+/******************************************************************************
+* Parareal iterations
+*******************************************************************************/
+int IS_Parareal::solve(){
+  IS_Config cc = config;
+  cc.deltaT     = config.deltaT*ratio;
+  cc.iterPerDay = config.iterPerDay/ratio;
+  delete coarse;
+  coarse = new IS_Model(cc);
+
+  string fileName = config.dir + "Parareal.dat";
+  FILE* datamatlabPR = fopen(fileName.c_str(), "w");
+  if (datamatlabPR==NULL){
+    cout << "Error opening file!!!\n Make sure the path is correct! \n";
+    return 1;
+  }
+  int status = iterate(datamatlabPR);
+  fclose(datamatlabPR);
+  if (status || writeSeries()) return 1;
+
+  cout << "Bacteria in the end : " << U[slices].scalars.A_T << "\n";
+  return 0;
+}
+
+/**
+ * Runs the iterations, one line of 'theFile' per iteration
+ */
+int IS_Parareal::iterate(FILE* theFile){
+  vector<IS_Checkpoint> G(slices), Fv(slices), Unew(slices+1);
+  IS_Checkpoint reference;
+  double serial = 0.0;
+  U.assign(slices+1, IS_Checkpoint());
+
+  //sequential fine run, for the real speedup and error
+  if (serialRun){
+    IS_Model model(config);
+    double t0 = wallTime();
+    if (model.reset() || model.step(bounds[slices])) return 1;
+    serial = wallTime() - t0;
+    model.getCheckpoint(reference);
+    cout << "Parareal : sequential run " << serial << " s\n";
+  }
+
+  //initial state and first coarse sweep
+  if (fine[0]->reset()) return 1;
+  fine[0]->getCheckpoint(U[0]);
+  double start = wallTime();
+  for(int n = 0; n < slices; n++){
+    if (propagateCoarse(n, U[n], G[n])) return 1;
+    U[n+1] = G[n];
+  }
+  double elapsed = wallTime() - start;
+  cout << "Parareal : " << slices << " slices, coarse sweep " << elapsed << " s\n";
+
+  int failed = 0;
+  for(int k = 0; k < maxIter && k < slices; k++){
+    double iterStart = wallTime();
+    double fineTime  = 0.0;
+
+    //fine solver on the slices not converged yet
+    #pragma omp parallel for schedule(dynamic) reduction(+:failed,fineTime)
+    for(int n = k; n < slices; n++){
+      double t0 = wallTime();
+      failed += propagateFine(n, U[n], Fv[n]);
+      fineTime += wallTime() - t0;
+    }
+    if (failed) return 1;
+    //estimate of a sequential run, from the first iteration
+    if (k == 0 && !serialRun) serial = fineTime;
+
+    //sequential correction
+    Unew[k] = U[k];
+    double worst = 0.0;
+    for(int n = k; n < slices; n++){
+      IS_Checkpoint Gnew;
+      if (n == k){
+        Gnew = G[n];
+      } else if (propagateCoarse(n, Unew[n], Gnew)){
+        return 1;
+      }
+      combine(Gnew, Fv[n], G[n], Unew[n+1]);
+      G[n] = Gnew;
+      worst = fmax(worst, defect(Unew[n+1], U[n+1]));
+    }
+    for(int n = k; n <= slices; n++) U[n] = Unew[n];
+
+    double iterTime = wallTime() - iterStart;
+    elapsed += iterTime;
+    cout << "Iteration " << k+1 << " : defect " << worst << ", " << iterTime << " s, "
+         << (serialRun ? "speedup " : "estimated speedup ") << serial/elapsed << "\n";
+    fprintf(theFile, "%d %.6E %.6E %.6E %.6E\n", k+1, worst, iterTime, elapsed, serial/elapsed);
+
+    if (worst < tol) break;
+  }
+  if (serialRun) cout << "Difference to the sequential run : " << defect(U[slices], reference) << "\n";
+  return 0;
+}
@@ -0,0 +1,78 @@
+#ifndef _IS_Parareal_H_
+#define _IS_Parareal_H_
+
+#include "IS_Model.h"
+
+/**
+ * Tissue and lymph node values of a time slice at the snapshot points
+ */
+struct IS_SliceSeries : public IS_Observer{
+  std::vector<long int> t;
+  std::vector<IS_Scalars> scalars;
+
+  void clear(){ t.clear(); scalars.clear(); }
+  int observe(const IS_Model& model, long int t){
+    this->t.push_back(t);
+    scalars.push_back(model.getScalars());
+    return 0;
+  }
+};
+
+/**
+ * Parareal: parallel in time solution of the model.
+ * 
+ * The simulated time is split in slices. Each iteration runs the fine
+ * solver (IS_Model with the given config) on every slice in parallel,
+ * from the current guess of the slice initial states, and corrects the
+ * guesses sequentially with the cheap coarse propagator, the same model
+ * with 'ratio' times the deltaT:
+ * 
+ *   U[n+1] = G(U_new[n]) + F(U_old[n]) - G(U_old[n])
+ * 
+ * until the slice boundary states change less than 'tol'. After as many
+ * iterations as slices the result is the one of the sequential solver.
+ * The coarse deltaT must stay stable for the diffusion (deltaT*ratio below
+ * deltaX^2/(6*d_ma) = 0.0055 with the default values).
+ * 
+ * Writes the time series of the fine solution ('L.dat', 'T.dat', 'B.dat',
+ * 'P.dat', see IS_FileObserver) and 'Parareal.dat': iteration, defect,
+ * iteration time, elapsed time and speedup. The speedup is measured
+ * against a sequential run with setSerialRun(1); otherwise it is an
+ * estimate, the sum of the fine slice times of the first iteration (taken
+ * while the slices share the cores and memory bandwidth) over the elapsed time.
+ */
+class IS_Parareal{
+
+  private:
+
+    IS_Config config;
+    int slices;
+    int ratio;
+    double tol;
+    int maxIter;
+    int serialRun;
+    std::vector<long int> bounds;     //first time step of each slice
+    std::vector<IS_Model*> fine;      //one fine solver per slice
+    IS_Model* coarse;
+    std::vector<IS_Checkpoint> U;     //slice boundary states
+    std::vector<IS_SliceSeries> series; //fine solution of each slice
+
+    int propagateFine(int n, const IS_Checkpoint& in, IS_Checkpoint& out);
+    int propagateCoarse(int n, const IS_Checkpoint& in, IS_Checkpoint& out);
+    int iterate(FILE* theFile);
+    int writeSeries();
+    IS_Parareal(const IS_Parareal&);
+    IS_Parareal& operator=(const IS_Parareal&);
+
+  public:
+    IS_Parareal(const IS_Config& cfg, int slices, int ratio = 5);
+    ~IS_Parareal();
+    void setTolerance(double tol, int maxIter);
+    void setSerialRun(int run);
+    int solve();
+    const IS_Checkpoint& getState(int n) const { return U[n]; }
+    int getSlices() const { return slices; }
+
+};
+
+#endif
@@ -0,0 +1,210 @@
+#include "IS_Sensitivity.h"
+
+/******************************************************************************
+ * 
+ * IS_Sensitivity - forward mode parameter sensitivities.
+ * 
+ * One run gives d(observable)/d(parameter) for every selected parameter,
+ * instead of two runs of IS_Model::solve() per parameter with finite
+ * differences.
+ * 
+ * Use-me : 
+ * 
+ *          IS_Sensitivity sens(config);
+ *          sens.select("beta_A");
+ *          sens.select("gamma_ma");
+ *          sens.solve();
+ * 
+ ******************************************************************************/
+
+using namespace std;
+
+IS_Sensitivity::IS_Sensitivity(const IS_Config& cfg){
+  this->config     = cfg;
+  this->config.simCase = 0;
+  this->A          = new IS_DualField[buffer];
+  this->MR         = new IS_DualField[buffer];
+  this->MA         = new IS_DualField[buffer];
+  this->F          = new IS_DualField[buffer];
+  this->deltaT     = cfg.deltaT;
+  this->iterPerDay = cfg.iterPerDay;
+  this->t          = 0;
+}
+
+IS_Sensitivity::~IS_Sensitivity(){
+  delete[] A;
+  delete[] MR;
+  delete[] MA;
+  delete[] F;
+}
+
+/**
+ * Adds a parameter, returns 1 if it does not exist or there are
+ * already IS_LANES parameters
+ */
+int IS_Sensitivity::select(const std::string& name){
+  IS_Params<double> p;
+  if (IS_ParamByName(p, name) == NULL){
+    cout << "Unknown parameter : " << name << "\n";
+    return 1;
+  }
+  if ((int)names.size() >= IS_LANES){
+    cout << "At most " << IS_LANES << " parameters per run\n";
+    return 1;
+  }
+  names.push_back(name);
+  return 0;
+}
+
+/**
+ * Takes the parameter values of the run and seeds the derivatives
+ */
+void IS_Sensitivity::initialize(){
+  IS_Params<double> p = IS_Model::getParams(config);
+
+#define IS_PARAM_DUAL(n) par.n = IS_Dual(p.n);
+  IS_PARAM_LIST(IS_PARAM_DUAL)
+#undef IS_PARAM_DUAL
+  for(size_t i = 0; i < names.size(); i++){
+    IS_ParamByName(par, names[i])->d[i] = 1.0;
+  }
+
+  //same discretization as IS_Model::initialize
+  deltaX = deltaY = deltaZ = 0.1;
+  tol    = pow(10,-6);
+
+  MA_T   = 0.0;
+  MA_L   = 0.0;
+  MR_T   = par.m_estrela;
+  Th     = par.th0;
+  B      = par.b0;
+  P      = par.p0;
+  F_T    = par.f0;
+  F_L    = par.f0;
+  A_T    = par.a0;
+
+  IS_InitialConditions(par, 0, A[0], MR[0], MA[0], F[0]);
+  t = 0;
+}
+
+/**
+ * Integral of the positive values, contact 0 all points,
+ * 1 points in contact with lymph vessels, 2 with blood vessels
+ */
+IS_Dual IS_Sensitivity::integral(const IS_DualField& vec, int contact){
+  IS_Dual V = 0.0;
+  for(int x = 0; x < Xspace; x++) {
+    for(int y = 0; y < Yspace; y++) {
+      for(int z = 0; z < Zspace; z++) {
+        if ((contact == 1 && !lymphContact(x,y,z))
+            || (contact == 2 && !bloodContact(x,y,z))) continue;
+        if (vec[x][y][z] > 0.0) V += vec[x][y][z];
+      }
+    }
+  }
+  if (V > 0.0) V = V/SPACE; else V = 0.0;
+  return V;
+}
+
+/**
+ * One time step, as IS_Model::advance for simCase 0
+ */
+void IS_Sensitivity::advance(){
+  if (t > 0){
+    MA_T = integral(MA[0], 1);
+    MR_T = integral(MR[0], 0);
+    F_T  = integral(F[0], 2);
+    A_T  = integral(A[0], 0);
+  }
+
+  IS_LymphNode(par, deltaT, MA_T, F_T, MA_L, Th, B, P, F_L);
+
+  #pragma omp parallel for schedule(static)
+  for(int x = 0; x < Xspace; x++) {
+    for(int y = 0; y < Yspace; y++) {
+      for(int z = 0; z < Zspace; z++) {
+        IS_CoupledPoint(par, deltaT, tol,
+          A[0][x][y][z], MR[0][x][y][z], MA[0][x][y][z], F[0][x][y][z],
+          IS_Laplacian(A[0],x,y,z,deltaX,deltaY,deltaZ), IS_Laplacian(MR[0],x,y,z,deltaX,deltaY,deltaZ),
+          IS_Laplacian(MA[0],x,y,z,deltaX,deltaY,deltaZ), IS_Laplacian(F[0],x,y,z,deltaX,deltaY,deltaZ),
+          bloodContact(x,y,z), lymphContact(x,y,z), MA_T, MA_L, F_T, F_L,
+          A[1][x][y][z], MR[1][x][y][z], MA[1][x][y][z], F[1][x][y][z]);
+      }
+    }
+  }
+
+  #pragma omp parallel for schedule(static)
+  for(int x = 0; x < Xspace; x++) {
+    for(int y = 0; y < Yspace; y++) {
+      for(int z = 0; z < Zspace; z++) {
+        A[0][x][y][z]  = A[1][x][y][z];
+        MR[0][x][y][z] = MR[1][x][y][z];
+        MA[0][x][y][z] = MA[1][x][y][z];
+        F[0][x][y][z]  = F[1][x][y][z];
+      }
+    }
+  }
+  t++;
+}
+
+void IS_Sensitivity::write(FILE* theFile, const IS_Dual& value){
+  fprintf(theFile, " %.6E", value.v);
+  for(size_t i = 0; i < names.size(); i++) fprintf(theFile, " %.6E", value.d[i]);
+}
+
+/******************************************************************************
+* Solve model and tangent equations
+*******************************************************************************/
+int IS_Sensitivity::solve(){
+  string fileName = config.dir + "S.dat";
+  long int value = ((int)iterPerDay*config.days)/config.points;
+  IS_Dual lastA_T;
+
+  FILE* datamatlabS = fopen(fileName.c_str(), "w");
+  if (datamatlabS==NULL){
+    cout << "Error opening file!!!\n Make sure the path is correct! \n";
+    return 1;
+  }
+  fprintf(datamatlabS, "# t");
+  const char* observables[7] = {"A_T", "MA_T", "MA_L", "Th", "B", "P", "F_L"};
+  for(int o = 0; o < 7; o++){
+    fprintf(datamatlabS, " %s", observables[o]);
+    for(size_t i = 0; i < names.size(); i++)
+      fprintf(datamatlabS, " d%s/d%s", observables[o], names[i].c_str());
+  }
+  fprintf(datamatlabS, "\n");
+
+  initialize();
+  cout << "Calculating sensitivities...\n";
+
+  do{
+    if (t%value == 0){
+      fprintf(datamatlabS, "%ld", t);
+      write(datamatlabS, A_T);
+      write(datamatlabS, MA_T);
+      write(datamatlabS, MA_L);
+      write(datamatlabS, Th);
+      write(datamatlabS, B);
+      write(datamatlabS, P);
+      write(datamatlabS, F_L);
+      fprintf(datamatlabS, "\n");
+    }
+    lastA_T = A_T;
+    advance();
+  }while((t < (iterPerDay*config.days)) && (A_T > tol));
+  fclose(datamatlabS);
+
+  /**
+   * Clearance time: A_T(t_c, p) = tol, so dt_c/dp = -(dA_T/dp)/(dA_T/dt)
+   * with dA_T/dt from the last time step.
+   */
+  if (!(A_T > tol)){
+    double rate = (A_T.v - lastA_T.v)/deltaT;
+    cout << "Bacteria cleared at iteration " << t << "\n";
+    for(size_t i = 0; i < names.size(); i++){
+      double dtc = (rate != 0.0) ? -lastA_T.d[i]/rate : 0.0;
+      cout << "d(clearance time)/d(" << names[i] << ") = " << dtc/(deltaT*iterPerDay) << " days\n";
+    }
+  }
+  return 0;
+}
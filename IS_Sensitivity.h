@@ -0,0 +1,53 @@
+#ifndef _IS_Sensitivity_H_
+#define _IS_Sensitivity_H_
+
+#include "IS_Model.h"
+#include "IS_Dual.h"
+
+typedef IS_Dual IS_DualField[Xspace][Yspace][Zspace];
+
+/**
+ * Forward mode sensitivities of the complete model (simCase 0).
+ * 
+ * Solves the equations of IS_Equations.h with IS_Dual values, so every
+ * field, integral and lymph node value carries its derivatives with
+ * respect to up to IS_LANES parameters chosen by name (see IS_PARAM_LIST).
+ * 
+ * Outputs 'S.dat' in the output directory, one line per point:
+ *   t A_T dA_T/dp... MA_T dMA_T/dp... MA_L ... Th ... B ... P ... F_L ...
+ * and the derivatives of the bacterial clearance time when it happens.
+ */
+class IS_Sensitivity{
+
+  private:
+
+    IS_Config config;
+    IS_Params<IS_Dual> par;
+    std::vector<std::string> names;
+    IS_DualField* A;
+    IS_DualField* MR;
+    IS_DualField* MA;
+    IS_DualField* F;
+    IS_Dual MA_T, MA_L, MR_T, Th, B, P, F_T, F_L, A_T;
+    double deltaT, iterPerDay, tol;
+    double deltaX, deltaY, deltaZ;
+    long int t;
+
+    IS_Dual integral(const IS_DualField& vec, int contact);
+    int bloodContact(int x, int y, int z) const { return IS_Model::bloodContact(config.bv, x, y, z); }
+    int lymphContact(int x, int y, int z) const { return IS_Model::lymphContact(config.lnv, x, y, z); }
+    void initialize();
+    void advance();
+    void write(FILE* theFile, const IS_Dual& value);
+    IS_Sensitivity(const IS_Sensitivity&);
+    IS_Sensitivity& operator=(const IS_Sensitivity&);
+
+  public:
+    IS_Sensitivity(const IS_Config& cfg);
+    ~IS_Sensitivity();
+    int select(const std::string& name);
+    int solve();
+
+};
+
+#endif
@@ -0,0 +1,206 @@
+#include "IS_Telemetry.h"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/******************************************************************************
+ *
+ * IS_Telemetry - live values of a running IS_Model in shared memory.
+ *
+ * Use-me :
+ *
+ *          config.telemetry = "/IS_run1";  // published by solve()
+ *
+ *          IS_TelemetryReader reader;      // in any other process
+ *          reader.attach("/IS_run1");
+ *          reader.poll(samples);           // new samples since the last poll
+ *
+ *          Or the 'telemetry' tool: ./telemetry /IS_run1 100
+ *
+ ******************************************************************************/
+
+using namespace std;
+
+static const char RING_MAGIC[4] = {'I','S','T','1'};
+
+static size_t ringBytes(int capacity){
+  return sizeof(IS_TelemetryRing) + (capacity - 1)*sizeof(IS_TelemetryRing::Slot);
+}
+
+static double monotonicTime(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+IS_Telemetry::IS_Telemetry(const std::string& name, int capacity){
+  this->name     = name;
+  this->capacity = (capacity < 1) ? 1 : capacity;
+  this->ring     = NULL;
+  this->bytes    = ringBytes(this->capacity);
+  this->last     = 0.0;
+}
+
+IS_Telemetry::~IS_Telemetry(){
+  if (ring){
+    ring->running.store(0, std::memory_order_release);
+    munmap(ring, bytes);
+    shm_unlink(name.c_str());
+  }
+}
+
+/**
+ * Creates the shared memory object (once) and empties the ring
+ */
+int IS_Telemetry::begin(const IS_Model& model){
+  if (ring == NULL){
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0 || ftruncate(fd, bytes) != 0){
+      cout << "Error creating the telemetry " << name << "\n";
+      if (fd >= 0) close(fd);
+      return 1;
+    }
+    void* p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED){
+      cout << "Error creating the telemetry " << name << "\n";
+      return 1;
+    }
+    ring = (IS_TelemetryRing*)p;
+  }
+  memcpy(ring->magic, RING_MAGIC, 4);
+  ring->capacity = capacity;
+  ring->pid      = getpid();
+  for(int i = 0; i < capacity; i++) ring->slots[i].seq.store(0, std::memory_order_relaxed);
+  ring->head.store(0, std::memory_order_release);
+  ring->running.store(1, std::memory_order_release);
+  last = 0.0;
+  return 0;
+}
+
+/**
+ * Publishes the values of time step t
+ */
+int IS_Telemetry::observe(const IS_Model& model, long int t){
+  double now = monotonicTime();
+  unsigned long long n = ring->head.load(std::memory_order_relaxed);
+  IS_TelemetryRing::Slot& slot = ring->slots[n % capacity];
+
+  slot.seq.store(2*n + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.sample.t        = t;
+  slot.sample.day      = model.getDay();
+  slot.sample.scalars  = model.getScalars();
+  slot.sample.stepTime = (last > 0.0) ? now - last : 0.0;
+  slot.seq.store(2*n + 2, std::memory_order_release);
+  ring->head.store(n + 1, std::memory_order_release);
+  last = now;
+  return 0;
+}
+
+int IS_Telemetry::end(const IS_Model& model, long int t){
+  ring->running.store(0, std::memory_order_release);
+  return 0;
+}
+
+IS_TelemetryReader::IS_TelemetryReader(){
+  ring   = NULL;
+  bytes  = 0;
+  next   = 0;
+  missed = 0;
+}
+
+IS_TelemetryReader::~IS_TelemetryReader(){
+  detach();
+}
+
+/**
+ * Maps the ring published as 'name' (read only)
+ */
+int IS_TelemetryReader::attach(const std::string& name){
+  struct stat st;
+  detach();
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) return 1;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(IS_TelemetryRing)){
+    close(fd);
+    return 1;
+  }
+  void* p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) return 1;
+  ring  = (IS_TelemetryRing*)p;
+  bytes = st.st_size;
+  if (memcmp(ring->magic, RING_MAGIC, 4) != 0 || ring->capacity < 1
+      || ringBytes(ring->capacity) > bytes){
+    detach();
+    return 1;
+  }
+  next   = 0;
+  missed = 0;
+  return 0;
+}
+
+void IS_TelemetryReader::detach(){
+  if (ring) munmap(ring, bytes);
+  ring = NULL;
+}
+
+/**
+ * Copies sample n, fails if it is not there or changed while copied
+ */
+int IS_TelemetryReader::read(unsigned long long n, IS_TelemetrySample& s) const{
+  const IS_TelemetryRing::Slot& slot = ring->slots[n % ring->capacity];
+  unsigned long long seq = slot.seq.load(std::memory_order_acquire);
+  if (seq != 2*n + 2) return 1;
+  memcpy(&s, (const void*)&slot.sample, sizeof(IS_TelemetrySample));
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return slot.seq.load(std::memory_order_relaxed) != seq;
+}
+
+/**
+ * Appends the samples published since the last call (at most max,
+ * the oldest first, 0 for all) and returns how many were read
+ */
+int IS_TelemetryReader::poll(std::vector<IS_TelemetrySample>& samples, size_t max){
+  if (ring == NULL) return 0;
+  unsigned long long head = ring->head.load(std::memory_order_acquire);
+  unsigned long long capacity = ring->capacity;
+  int count = 0;
+
+  if (head < next) next = 0; //the run was restarted
+  if (head - next > capacity){
+    missed += head - next - capacity;
+    next = head - capacity;
+  }
+  if (max && head - next > max) head = next + max;
+  for(; next < head; next++){
+    IS_TelemetrySample s;
+    if (read(next, s)){
+      missed++;
+      continue;
+    }
+    samples.push_back(s);
+    count++;
+  }
+  return count;
+}
+
+/**
+ * Most recent sample
+ */
+int IS_TelemetryReader::latest(IS_TelemetrySample& s) const{
+  if (ring == NULL) return 1;
+  unsigned long long head = ring->head.load(std::memory_order_acquire);
+  if (head == 0) return 1;
+  return read(head - 1, s);
+}
+
+/**
+ * 1 while the simulation is publishing
+ */
+int IS_TelemetryReader::running() const{
+  return ring && ring->running.load(std::memory_order_acquire);
+}
@@ -0,0 +1,96 @@
+#ifndef _IS_Telemetry_H_
+#define _IS_Telemetry_H_
+
+#include "IS_Model.h"
+#include <atomic>
+
+#if ATOMIC_LLONG_LOCK_FREE != 2
+#error "IS_Telemetry needs lock free 64 bit atomics"
+#endif
+
+/**
+ * Values published at every time step
+ */
+struct IS_TelemetrySample{
+  long int t;
+  double day;
+  IS_Scalars scalars;
+  double stepTime; //seconds taken by the previous step
+};
+
+/**
+ * Shared memory ring of samples. Slot n%capacity holds sample n; its seq
+ * is odd while the sample is written and 2*(n+1) after, so the readers
+ * can tell a complete sample from one being overwritten.
+ */
+struct IS_TelemetryRing{
+  char magic[4];
+  int capacity;
+  long int pid;
+  std::atomic<unsigned long long> head;    //samples published
+  std::atomic<unsigned long long> running; //0 once the run is over
+  struct Slot{
+    std::atomic<unsigned long long> seq;
+    IS_TelemetrySample sample;
+  } slots[1];
+};
+
+/**
+ * Publishes the model state at every time step in the shared memory
+ * object 'name' (e.g. "/IS_run1"). Single producer, the solver never
+ * waits: the oldest samples are overwritten when the readers fall behind.
+ * Register with interval 1 (IS_Config::telemetry does it in solve()).
+ */
+class IS_Telemetry : public IS_Observer{
+
+  private:
+
+    std::string name;
+    int capacity;
+    IS_TelemetryRing* ring;
+    size_t bytes;
+    double last;
+
+    IS_Telemetry(const IS_Telemetry&);
+    IS_Telemetry& operator=(const IS_Telemetry&);
+
+  public:
+    IS_Telemetry(const std::string& name, int capacity = 4096);
+    ~IS_Telemetry();
+    int begin(const IS_Model& model);
+    int observe(const IS_Model& model, long int t);
+    int end(const IS_Model& model, long int t);
+
+};
+
+/**
+ * Attaches to the ring of a running simulation. Reading never blocks or
+ * slows down the solver; samples overwritten before being read are
+ * counted in lost().
+ */
+class IS_TelemetryReader{
+
+  private:
+
+    IS_TelemetryRing* ring;
+    size_t bytes;
+    unsigned long long next;
+    unsigned long long missed;
+
+    int read(unsigned long long n, IS_TelemetrySample& s) const;
+    IS_TelemetryReader(const IS_TelemetryReader&);
+    IS_TelemetryReader& operator=(const IS_TelemetryReader&);
+
+  public:
+    IS_TelemetryReader();
+    ~IS_TelemetryReader();
+    int attach(const std::string& name);
+    void detach();
+    int poll(std::vector<IS_TelemetrySample>& samples, size_t max = 0);
+    int latest(IS_TelemetrySample& s) const;
+    int running() const;
+    unsigned long long lost() const { return missed; }
+
+};
+
+#endif
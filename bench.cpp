@@ -0,0 +1,58 @@
+#include "IS_Model.h"
+#include <sys/time.h>
+
+using namespace std;
+
+static double wallTime(){
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+/**
+ * Time per step of the complete model (simCase 0) with each field layout
+ * (IS_Layout.h) on a grid of IS_GRID^3 points, best of 'repeats' runs of
+ * 'steps' time steps. Both layouts must give the same A_T.
+ * Build once per grid size, e.g. IS_GRID = 10 (default), 32, 64, 128.
+ *
+ * Use-me : g++ -O2 -fopenmp -DIS_GRID=64 -o bench bench.cpp IS_*.cpp -lz
+ *          ./bench [steps] [repeats]
+ */
+int main(int argc, char* argv[]){
+  const char* names[2] = {"SoA  ", "AoSoA"};
+  const int layouts[2] = {IS_SOA, IS_AOSOA};
+  long int steps = (argc > 1) ? atol(argv[1]) : 1 + 20000000L/SPACE;
+  int repeats    = (argc > 2) ? atoi(argv[2]) : 3;
+  double best[2], A_T[2];
+
+  for(int l = 0; l < 2; l++){
+    IS_Config cfg;
+    cfg.simCase      = 0;
+    cfg.saveFiles    = 0;
+    cfg.days         = 1000;
+    cfg.healthChecks = 0;
+    cfg.layout       = layouts[l];
+    IS_Model model(cfg);
+
+    best[l] = INFINITY;
+    for(int r = 0; r < repeats; r++){
+      if (model.reset()) return 1;
+      model.step(1); //first touch of the caches
+      long int first = model.getStep();
+      double start = wallTime();
+      model.step(steps);
+      //per step, in case the bacteria were gone earlier
+      double elapsed = (wallTime() - start)/(model.getStep() - first);
+      if (elapsed < best[l]) best[l] = elapsed;
+    }
+    A_T[l] = model.getScalars().A_T;
+    printf("grid %d^3 %s : %.4f ms/step %.1f Mpoints/s (A_T = %.6E)\n", Xspace, names[l],
+           1e3*best[l], SPACE/best[l]*1e-6, A_T[l]);
+  }
+  printf("AoSoA speedup : %.2f\n", best[0]/best[1]);
+  if (A_T[0] != A_T[1]){
+    cout << "The layouts gave different results!!!\n";
+    return 1;
+  }
+  return 0;
+}
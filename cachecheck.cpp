@@ -0,0 +1,81 @@
+#include "IS_Cache.h"
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+
+using namespace std;
+
+/**
+ * Files of dir a that are missing or different in dir b
+ */
+static int compare(const string& a, const string& b){
+  int differ = 0;
+  DIR* d = opendir(a.c_str());
+  if (d==NULL) return 1;
+  struct dirent* f;
+  while((f = readdir(d)) != NULL){
+    if (f->d_name[0] == '.') continue;
+    FILE* fa = fopen((a + f->d_name).c_str(), "rb");
+    FILE* fb = fopen((b + f->d_name).c_str(), "rb");
+    int ca = 0, cb = 0;
+    while(fa && fb && (ca = fgetc(fa)) == (cb = fgetc(fb)) && ca != EOF);
+    if (fa == NULL || fb == NULL || ca != cb){
+      cout << "  " << b << f->d_name << " differs\n";
+      differ = 1;
+    }
+    if (fa) fclose(fa);
+    if (fb) fclose(fb);
+  }
+  closedir(d);
+  return differ;
+}
+
+static void clean(const string& dir){
+  DIR* d = opendir(dir.c_str());
+  struct dirent* f;
+  while(d && (f = readdir(d)) != NULL){
+    if (f->d_name[0] != '.') unlink((dir + f->d_name).c_str());
+  }
+  if (d) closedir(d);
+  mkdir(dir.c_str(), 0755);
+}
+
+/**
+ * Checks that runs answered by IS_Cache write the same files as runs
+ * without it, with the number of points kept fixed while the number of
+ * days changes: 1 day (solved), again (read), 2 and 3 days (continued
+ * from the end state at the interval of the entry) and 1 day with other
+ * points (snapshot interval not a multiple of the cached one, solved).
+ *
+ * Use-me : ./cachecheck [dir/]
+ */
+int main(int argc, char* argv[]){
+  string base = (argc > 1) ? argv[1] : "output/cachecheck/";
+  const int days[5]   = {1, 1, 2, 3, 1};
+  const int points[5] = {40, 40, 40, 40, 30};
+  const char* expect[5] = {"solved", "read", "continued", "continued", "solved"};
+  int failed = 0;
+
+  mkdir(base.c_str(), 0755);
+  IS_Cache cache(base + "cache/");
+  clean(base + "cache/" + cache.key(IS_Config()) + "/");
+  for(int r = 0; r < 5; r++){
+    IS_Config cfg;
+    cfg.days      = days[r];
+    cfg.points    = points[r];
+    cfg.dumpEvery = 4;
+    cfg.dir = base + "ref/";
+    clean(cfg.dir);
+    IS_Model model(cfg);
+    if (model.solve()) return 1;
+
+    cfg.dir = base + "cached/";
+    clean(cfg.dir);
+    cout << "Run " << r+1 << " : " << days[r] << " days, " << points[r] << " points, "
+         << expect[r] << "\n";
+    if (cache.solve(cfg)) return 1;
+    if (compare(base + "ref/", base + "cached/")) failed = 1;
+  }
+  cout << (failed ? "The cached results differ!!!\n" : "Same results with and without cache\n");
+  return failed;
+}
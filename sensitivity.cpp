@@ -0,0 +1,93 @@
+#include "IS_Sensitivity.h"
+
+using namespace std;
+
+/**
+ * Checks the forward mode derivatives of IS_Sensitivity against central
+ * finite differences of IS_Model, (f(p+h) - f(p-h))/2h with h relative to
+ * the parameter, at the last point of S.dat. Exits with 1 if a derivative
+ * differs by more than 'tol' (relative). Keep h small: the thresholds of
+ * the equations (tol) make larger differences cross a branch.
+ *
+ * Use-me : ./sensitivity beta_A [days] [h] [tol]
+ */
+int main(int argc, char* argv[]){
+  const char* observables[7] = {"A_T", "MA_T", "MA_L", "Th", "B", "P", "F_L"};
+  double dual[7][2], fd[7];
+
+  if (argc < 2){
+    cout << "Use : " << argv[0] << " parameter [days] [h] [tol]\n";
+    return 1;
+  }
+  string name = argv[1];
+  IS_Config cfg;
+  cfg.simCase      = 0;
+  cfg.saveFiles    = 0;
+  cfg.days         = (argc > 2) ? atoi(argv[2]) : 1;
+  cfg.points       = 10*cfg.days;
+  cfg.healthChecks = 0;
+  double h         = (argc > 3) ? atof(argv[3]) : pow(10,-6);
+  double tol       = (argc > 4) ? atof(argv[4]) : pow(10,-3);
+
+  //forward mode
+  IS_Sensitivity sens(cfg);
+  if (sens.select(name) || sens.solve()) return 1;
+
+  string fileName = cfg.dir + "S.dat";
+  FILE* datamatlabS = fopen(fileName.c_str(), "r");
+  if (datamatlabS==NULL){
+    cout << "Error opening file!!!\n Make sure the path is correct! \n";
+    return 1;
+  }
+  char line[4096];
+  long int t = -1;
+  while(fgets(line, sizeof(line), datamatlabS)){
+    long int lt;
+    double v[14];
+    if (line[0] == '#') continue;
+    if (sscanf(line, "%ld %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf", &lt,
+               &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6],
+               &v[7], &v[8], &v[9], &v[10], &v[11], &v[12], &v[13]) != 15) continue;
+    t = lt;
+    for(int o = 0; o < 7; o++){
+      dual[o][0] = v[2*o];
+      dual[o][1] = v[2*o + 1];
+    }
+  }
+  fclose(datamatlabS);
+  if (t < 0){
+    cout << "No values in " << fileName << "\n";
+    return 1;
+  }
+
+  //finite differences, same time step as the last line of S.dat
+  IS_Params<double> p = IS_Model::getParams(cfg);
+  double p0   = *IS_ParamByName(p, name);
+  double step = (p0 != 0.0) ? h*fabs(p0) : h;
+  IS_Scalars s[2];
+  for(int k = 0; k < 2; k++){
+    IS_Config c = cfg;
+    c.params[name] = p0 + (k ? -step : step);
+    IS_Model model(c);
+    if (model.reset() || model.step(t)) return 1;
+    s[k] = model.getScalars();
+  }
+  double plus[7]  = {s[0].A_T, s[0].MA_T, s[0].MA_L, s[0].Th, s[0].B, s[0].P, s[0].F_L};
+  double minus[7] = {s[1].A_T, s[1].MA_T, s[1].MA_L, s[1].Th, s[1].B, s[1].P, s[1].F_L};
+
+  int failed = 0;
+  printf("# d/d%s at iteration %ld\n# observable value forward finite-differences relative-error\n",
+         name.c_str(), t);
+  for(int o = 0; o < 7; o++){
+    fd[o] = (plus[o] - minus[o])/(2*step);
+    double scale = fabs(fd[o]) > fabs(dual[o][1]) ? fabs(fd[o]) : fabs(dual[o][1]);
+    double error = (scale > 0.0) ? fabs(fd[o] - dual[o][1])/scale : 0.0;
+    //derivatives lost in the rounding of the values are not compared
+    if (scale*step < pow(10,-12)*fabs(dual[o][0])) error = 0.0;
+    if (error > tol) failed = 1;
+    printf("%-4s %.6E %.6E %.6E %.2E%s\n", observables[o], dual[o][0], dual[o][1], fd[o],
+           error, (error > tol) ? " <-" : "");
+  }
+  if (failed) cout << "The derivatives differ from the finite differences!!!\n";
+  return failed;
+}
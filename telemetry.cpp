@@ -0,0 +1,50 @@
+#include "IS_Telemetry.h"
+#include <unistd.h>
+
+using namespace std;
+
+/**
+ * Prints the live values of a simulation run with IS_Config::telemetry,
+ * polling every 'ms' milliseconds, until the run is over. 'latest' prints
+ * only the most recent value of each poll.
+ *
+ * Use-me : ./telemetry /IS_run1 100 [latest]
+ */
+int main(int argc, char* argv[]){
+  IS_TelemetryReader reader;
+  vector<IS_TelemetrySample> samples;
+
+  if (argc < 2){
+    cout << "Use : " << argv[0] << " name [ms] [latest]\n";
+    return 1;
+  }
+  int ms     = (argc > 2) ? atoi(argv[2]) : 100;
+  int latest = (argc > 3) && string(argv[3]) == "latest";
+  if (reader.attach(argv[1])){
+    cout << "No simulation publishing to " << argv[1] << "\n";
+    return 1;
+  }
+
+  printf("# t day A_T MA_T MR_T F_T MA_L Th B P F_L stepTime\n");
+  int running = 1;
+  while(running){
+    running = reader.running();
+    samples.clear();
+    if (latest){
+      IS_TelemetrySample s;
+      if (reader.latest(s) == 0) samples.push_back(s);
+    } else {
+      reader.poll(samples);
+    }
+    for(size_t i = 0; i < samples.size(); i++){
+      const IS_TelemetrySample& s = samples[i];
+      const IS_Scalars& v = s.scalars;
+      printf("%ld %.6f %.6E %.6E %.6E %.6E %.6E %.6E %.6E %.6E %.6E %.3E\n", s.t, s.day,
+             v.A_T, v.MA_T, v.MR_T, v.F_T, v.MA_L, v.Th, v.B, v.P, v.F_L, s.stepTime);
+    }
+    fflush(stdout);
+    if (running) usleep(ms*1000);
+  }
+  if (reader.lost()) printf("# %llu samples lost\n", reader.lost());
+  return 0;
+}
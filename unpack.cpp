@@ -0,0 +1,41 @@
+#include "IS_Compress.h"
+
+using namespace std;
+
+/**
+ * Converts a compressed snapshot 'S_t.isz' back to the csv files
+ * 'A_t.csv', 'Mr_t.csv', 'Ma_t.csv', 'F_t.csv' in the given directory.
+ * 
+ * Use-me : ./unpack output/S_416.isz output/
+ */
+int main(int argc, char* argv[]){
+  const char* names[IS_SPECIES] = {"A", "Mr", "Ma", "F"};
+  char fileName[512];
+  IS_Snapshot snap;
+
+  if (argc < 3){
+    cout << "Use : " << argv[0] << " snapshot.isz outdir/\n";
+    return 1;
+  }
+  if (IS_ReadSnapshot(argv[1], snap)) return 1;
+
+  for(int s = 0; s < IS_SPECIES; s++){
+    snprintf(fileName, sizeof(fileName), "%s%s_%ld.csv", argv[2], names[s], snap.t);
+    FILE* data = fopen(fileName, "w");
+    if (data==NULL){
+      cout << "Error opening file!!!\n Make sure the path is correct! \n";
+      return 1;
+    }
+    for(int x = 0; x < snap.X; x++) {
+      for(int y = 0; y < snap.Y; y++) {
+        for(int z = 0; z < snap.Z; z++) {
+          fprintf(data, "%d %d %d %E", x, y, z, snap.at(s,x,y,z));
+          if (!(x+1 == snap.X && y+1 == snap.Y && z+1 == snap.Z)) fprintf(data, "\n");
+        }
+      }
+    }
+    fclose(data);
+    cout << fileName << " (max error " << snap.error[s] << ")\n";
+  }
+  return 0;
+}